@@ -19,11 +19,38 @@
  *      - размер страницы зависит от конкретной м/сх памяти, страницы логически объединяются в сектора и блоки памяти
  *      - для AT45DBXXX: блок памяти содержит в 8 страниц; сектор памяти содержит 128/256/512/1024 страниц; логическая организация памяти: страница->блок->сектор
  *      - для W25QXXX:   сектор памяти содержит 16 страниц; блок памяти содержит 256 страниц; логическая организация памяти: страница->сектор->блок
+ *      - Flash_Read читает массив произвольной длины по линейному адресу одной командой, данные принимаются через DMA
+ *      - завершение DMA драйвер узнаёт из Flash_DmaComplete: её вызывают HAL_SPI_RxCpltCallback/HAL_SPI_ErrorCallback приложения (или драйвера при _FLASH_DMA_CALLBACKS = 1)
+ *      - Flash_Write записывает массив произвольной длины по линейному адресу: деление по границам страниц, целые страницы идут подряд (AT45DBXXX заполняет один SRAM-буфер, пока программируется другой)
+ *      - Flash_ReadV/Flash_WriteV читают и пишут массив из нескольких буферов (FLASH_Seg_t) одной командой: сегменты идут подряд в одном Chip Select без промежуточного буфера; AT45DBXXX собирает сегменты в SRAM-буфере, сохраняя остальные байты страницы
+ *      - м/сх описываются строками таблицы flashParts (геометрия, команды, типовые и максимальные времена); м/сх, которой нет в таблице, описывается по SFDP
+ *      - _FLASH_FAMILY (1 - AT45DBXXX, 2 - NOR) и _FLASH_PG_SHIFT собирают драйвер под одно семейство и один размер страницы: ветви и строки таблицы другого семейства не компилируются, адрес страницы - постоянный сдвиг; м/сх другого семейства или с другой страницей Flash_Init не принимает (0 -> определение при Flash_Init); выигрыш - размер кода (make -C test bench, x86-64 -O2: около 3,6 Кб из 23 Кб), по тактам процессора разница со сборкой по умолчанию меньше разброса замеров
+ *      - при _FLASH_AT45_BINARY = 1 AT45DBXXX переводится на страницу 2^n байт: линейный адрес и размеры блоков LittleFS - степени двойки (Flash_LfsConfig)
+ *      - драйвер помнит, спит ли м/сх: 0xAB отправляется только спящей м/сх; при _FLASH_IDLE_MS > 0 м/сх усыпляется после простоя (Flash_IdleTask)
+ *      - все функции принимают устройство FLASH_t *: у каждой м/сх своя шина, выводы и мьютекс (flash - устройство по умолчанию, FLASH_DEVICE - описание других); м/сх на общей шине обязаны указывать BusOwner - одно устройство шины, чей мьютекс разделяет их обмены
+ *      - FLASH_STRIPE объединяет две м/сх в одно устройство с чередованием страниц: обе м/сх программируют/стирают и читают по DMA одновременно
+ *      - чтение других страниц приостанавливает идущее программирование/стирание (W25: 0x75/0x7A, AT45DBXXXE: 0xB0/0xD0, прочие - по SFDP); стирание чипа не приостанавливается; операция приостанавливается не больше _FLASH_SUSPEND_MAX раз, после чего чтения ждут её завершения
+ *      - при _FLASH_USE_FTL = 1 и Flash_FtlInit функции-прокладки работают через слой трансляции блоков: стирание блока LittleFS - выдача заранее стёртого наименее изношенного блока, старые блоки стирает фоновая задача (м/сх, у которой блоков больше _FLASH_FTL_BLOCKS, Flash_FtlInit не принимает)
+ *      - при _FLASH_USE_SCHED = 1 (FreeRTOS) запросы задач (Flash_Submit) выполняет задача планировщика: чтения - раньше записей и стираний, соседние чтения и записи объединяются в одну команду; о завершении задача узнаёт по уведомлению с индексом _FLASH_NOTIFY_INDEX (индекс 0 остаётся самой задаче)
+ *      - при _FLASH_PREFETCH_PAGES > 0 последовательные чтения (Flash_ReadPage, Flash_Read, функции-прокладки) упреждаются: следующие страницы принимаются по DMA в кольцо, пока задача обрабатывает текущие; запись и стирание сбрасывают устаревшие страницы кольца (flashPrefetchStats); м/сх на общей шине без BusOwner не упреждаются
+ *      - функции-прокладки переводят блок и смещение LittleFS в страницу м/сх, целые страницы читают одной командой мимо кэша и возвращают коды ошибок LittleFS; Flash_LfsConfig заполняет функции, геометрию и размеры буферов
+ *      - кэш страниц функций-прокладок (_FLASH_CACHE_PAGES, 0 - отключён) согласован с прямыми вызовами: запись и стирание мимо кэша (Flash_Write, Flash_WritePage(s), Flash_EraseRange и др.) удаляют строки своих страниц, их несохранённые изменения теряются
+ *      - обращения к HAL идут через макросы порта: файл -D_FLASH_PORT="..." заменяет их и объявляет типы HAL (сборка на ПК с моделью м/сх - test/)
  *      - в конце кода драйвера прикручены функции-прокладки, необходимые для обеспечения совместной работы с LittleFS
  */
 
+#include <string.h>
+
 #include "spiflash.h"
 
+#ifdef _FLASH_PORT                                                              // файл порта (-D_FLASH_PORT="...") переопределяет настройки и обращения к HAL ниже
+    #include _FLASH_PORT                                                        // и объявляет используемые типы HAL (HAL_StatusTypeDef), например, для сборки на ПК с моделью м/сх (test/)
+#else
+    #include "spi.h"                                                            // HAL SPI и выводы платы (CubeMX)
+    #include "equipment.h"                                                      // DELAY: пауза после сброса м/сх
+#endif
+
+#ifndef _FLASH_SPI
 #define _FLASH_SPI              hspi1                                           // осуществление взаимодействия с м/сх FLASH-памяти по SPI1
 #define _FLASH_CS_GPIO          SPI1_NSS_GPIO_Port                              // определение порта Chip Select Flash (Negative SS SPI1)
 #define _FLASH_CS_PIN           SPI1_NSS_Pin
@@ -31,506 +58,2849 @@
 #define _FLASH_WP_PIN           NWP_FLSH_Pin
 #define _FLASH_RST_GPIO         NRST_FLSH_GPIO_Port                             // определение порта Reset Flash
 #define _FLASH_RST_PIN          NRST_FLSH_Pin
+#endif
 
-
-
+#ifndef _FLASH_USE_FREERTOS
 #define _FLASH_USE_FREERTOS     1                                               // =1 -> работа в многозадачной среде
+#endif
 #if (_FLASH_USE_FREERTOS == 1)
     #include "cmsis_os.h"
+#endif
+#ifndef _FLASH_DELAY
+#if (_FLASH_USE_FREERTOS == 1)
     #define _FLASH_DELAY(x)     osDelay(x)
 #else
     #define _FLASH_DELAY(x)     HAL_Delay(x)
 #endif
+#endif
 
-FLASH_t          flash;
+// обращения к HAL: файл порта может заменить их моделью
+#ifndef _FLASH_TICK
+    #define _FLASH_TICK()                   HAL_GetTick ()                      // текущее время (мс)
+#endif
+#ifndef _FLASH_PIN
+    #define _FLASH_PIN(gpio, pin, high)     HAL_GPIO_WritePin ((GPIO_TypeDef*)(gpio), pin, (high) ? GPIO_PIN_SET : GPIO_PIN_RESET)  // установка уровня вывода
+#endif
+#ifndef _FLASH_DELAY_US
+    #define _FLASH_DELAY_US(us)             do { for (volatile uint32_t _n = (us) * (SystemCoreClock / 4000000u); _n; _n--); } while (0)  // короткая пауза без сна (мкс, не меньше заданной)
+#endif
+#ifndef _FLASH_IRQ_OFF
+    #define _FLASH_IRQ_OFF()                __disable_irq ()                    // запрет прерываний
+    #define _FLASH_IRQ_ON()                 __enable_irq ()                     // разрешение прерываний
+#endif
+#ifndef _FLASH_SPI_TX
+    #define _FLASH_SPI_TX(bus, buf, len, tmo)     HAL_SPI_Transmit ((SPI_HandleTypeDef*)(bus), buf, len, tmo)              // передача по SPI устройства (результат - HAL_StatusTypeDef)
+    #define _FLASH_SPI_RX(bus, buf, len, tmo)     HAL_SPI_Receive  ((SPI_HandleTypeDef*)(bus), buf, len, tmo)              // приём по SPI
+    #define _FLASH_SPI_TXRX(bus, tx, rx, len, tmo) HAL_SPI_TransmitReceive ((SPI_HandleTypeDef*)(bus), tx, rx, len, tmo)  // одновременные передача и приём
+    #define _FLASH_SPI_RX_DMA(bus, buf, len)      HAL_SPI_Receive_DMA ((SPI_HandleTypeDef*)(bus), buf, len)                // запуск приёма по DMA
+    #define _FLASH_SPI_ABORT(bus)                 HAL_SPI_Abort ((SPI_HandleTypeDef*)(bus))                                // останов передачи
+#endif
 
-// ------------------------------- Базовые функции для работы с м/сх FLASH-памяти: -----------------------------------------------------
+#ifndef _FLASH_USE_QSPI
+#define _FLASH_USE_QSPI         0                                               // =1 -> обмен через QUADSPI (многолинейные режимы чтения), =0 -> через обычный SPI (одна линия)
+#endif
+#define _FLASH_QSPI_LINES       4                                               // количество линий данных при чтении через QUADSPI: 1, 2 или 4
+#if (_FLASH_USE_QSPI == 1)
+    #include "quadspi.h"
+    #define _FLASH_QSPI         hqspi                                           // осуществление взаимодействия с м/сх FLASH-памяти по QUADSPI
+#endif
 
-uint8_t Flash_Spi           (uint8_t data)                                      // функция одновременного чтения/отправки посылки из 8 бит из/в микросхемы(у) FLASH-памяти
-{
-    uint8_t ret             = 0;
-    HAL_SPI_TransmitReceive(&_FLASH_SPI, &data, &ret, 1, 10);                   // отправка/чтение заданной команды/данных
-    return ret;
-}
+#ifndef _FLASH_USE_DMA
+#define _FLASH_USE_DMA          1                                               // =1 -> потоковое чтение массивов данных через DMA
+#endif
+#ifndef _FLASH_DMA_CALLBACKS
+#define _FLASH_DMA_CALLBACKS    0                                               // =1 -> обработчики завершения DMA (HAL_SPI_RxCpltCallback/HAL_SPI_ErrorCallback) определяет драйвер,
+#endif                                                                          // =0 -> их определяет приложение и вызывает из них Flash_DmaComplete (hspi, true/false)
+#define _FLASH_DMA_MIN          32                                              // минимальная длина фазы данных, для которой выгоден запуск DMA
+#define _FLASH_XFER_MAX         0xFFFF                                          // максимальная длина одной посылки HAL (поле Size имеет тип uint16_t)
+#define _FLASH_FRAME_MAX        16                                              // размер кадра: команда + адрес + фиктивные байты + короткая фаза данных
+#define _FLASH_TIMEOUT(len)     (10 + ((len) >> 6))                             // допустимое время передачи посылки заданной длины (мс)
+#ifndef _FLASH_CACHE_PAGES
+#define _FLASH_CACHE_PAGES      4                                               // количество страниц в кэше функций-прокладок LittleFS (0 -> кэш отключён)
+#endif
+#define _FLASH_CACHE_PGSIZE     1056                                            // наибольший размер страницы м/сх, который помещается в строку кэша
+#ifndef _FLASH_AT45_BINARY
+#define _FLASH_AT45_BINARY      0                                               // =1 -> AT45DBXXX со страницей 264/528/1056 байт переводится на страницу 2^n байт (у серии D - необратимо!)
+#endif
+#ifndef _FLASH_USE_STATS
+#define _FLASH_USE_STATS        0                                               // =1 -> счётчики, задержки и гистограммы задержек операций (Flash_GetStats), =0 -> не компилируются
+#endif
+#ifndef _FLASH_IDLE_MS
+#define _FLASH_IDLE_MS          0                                               // простой м/сх (мс), после которого она усыпляется командой 0xB9 (0 -> автоматического усыпления нет)
+#endif
+#ifndef _FLASH_SUSPEND_MAX
+#define _FLASH_SUSPEND_MAX      8                                               // наибольшее количество приостановок одной операции программирования/стирания ради чтения: дальше чтения ждут её завершения
+#endif
+#define _FLASH_SUSPEND_POLLS    4                                               // приостановка, не вступившая в силу за столько дополнительных tSUS, отменяется: чтение ждёт завершения операции
+#define _FLASH_CE_POLL_MS       50                                              // интервал опроса готовности при стирании чипа, когда типовое время уже истекло (мс)
+#ifndef _FLASH_DEVICES
+#define _FLASH_DEVICES          4                                               // наибольшее количество м/сх, с которыми одновременно работает драйвер (Flash_Init следующей возвращает false)
+#endif
+#ifndef _FLASH_FAMILY
+#define _FLASH_FAMILY           0                                               // семейство всех м/сх платы (1 - AT45DBXXX, 2 - NOR: значения FLASH_Family_t): код и строки таблицы другого семейства не компилируются (0 -> по опознанной м/сх)
+#endif
+#ifndef _FLASH_PG_SHIFT
+#define _FLASH_PG_SHIFT         0                                               // log2 размера страницы всех м/сх платы (страница 2^n байт): номер страницы и смещение - постоянные сдвиги (0 -> по опознанной м/сх)
+#endif
+#ifndef _FLASH_USE_FTL
+#define _FLASH_USE_FTL          0                                               // =1 -> слой трансляции блоков под функциями-прокладками LittleFS (Flash_FtlInit), =0 -> не компилируется
+#endif
+#define _FLASH_FTL_DEVICES      1                                               // наибольшее количество м/сх с FTL
+#ifndef _FLASH_FTL_BLOCKS
+#define _FLASH_FTL_BLOCKS       512                                             // наибольшее количество физических блоков под FTL (ОЗУ: 7 байт на блок); у м/сх с большим числом блоков Flash_FtlInit возвращает false
+#endif
+#define _FLASH_FTL_SPARE        8                                               // запас блоков, которые стираются заранее (не видны LittleFS)
+#define _FLASH_FTL_POLL_MS      5                                               // интервал шагов фоновой задачи FTL, пока есть работа (мс)
+#define _FLASH_FTL_STACK        256                                             // размер стека фоновой задачи FTL (слова)
+#define _FLASH_FTL_PRIORITY     (tskIDLE_PRIORITY + 1)                          // приоритет фоновой задачи FTL: ниже задач-писателей
+#ifndef _FLASH_USE_SCHED
+#define _FLASH_USE_SCHED        0                                               // =1 -> очередь запросов с отдельной задачей (Flash_SchedInit, только FreeRTOS), =0 -> запросы выполняются сразу
+#endif
+#define _FLASH_SCHED_BATCH      8                                               // наибольшее количество запросов, объединяемых в одну команду
+#define _FLASH_SCHED_MERGE      4096                                            // размер буфера объединённой команды (байт)
+#define _FLASH_SCHED_AGE_MS     50                                              // ожидание, после которого запрос обслуживается в порядке очереди (чтения его больше не обгоняют)
+#define _FLASH_SCHED_STACK      384                                             // размер стека задачи планировщика (слова)
+#define _FLASH_SCHED_PRIORITY   (tskIDLE_PRIORITY + 2)                          // приоритет задачи планировщика
+#ifndef _FLASH_NOTIFY_INDEX
+#define _FLASH_NOTIFY_INDEX     1                                               // индекс уведомления задачи о завершении запроса (FreeRTOS >= 10.4): индекс 0 остаётся задаче
+#endif
+#if (_FLASH_USE_FREERTOS == 1 && defined(configTASK_NOTIFICATION_ARRAY_ENTRIES) && _FLASH_NOTIFY_INDEX >= configTASK_NOTIFICATION_ARRAY_ENTRIES)
+    #error "_FLASH_NOTIFY_INDEX: configTASK_NOTIFICATION_ARRAY_ENTRIES too small"
+#endif
+#ifndef _FLASH_PREFETCH_PAGES
+#define _FLASH_PREFETCH_PAGES   0                                               // кольцо упреждающего чтения (страниц, чётное, до 64): половины по очереди принимают следующие страницы по DMA (0 -> отключено)
+#endif
+#define _FLASH_PREFETCH_DEVICES 1                                               // наибольшее количество м/сх с упреждающим чтением (кольца выдаются в порядке Flash_Init)
+#define _FLASH_PREFETCH_TRIGGER 2                                               // количество чтений подряд, продолжающих предыдущее, после которого запускается упреждающее чтение
+
+#if (_FLASH_PREFETCH_PAGES > 0 && _FLASH_USE_DMA == 1 && _FLASH_USE_QSPI == 0)
+    #define FLASH_PREFETCH      1                                               // упреждающее чтение: приём идёт по DMA, пока задача обрабатывает прочитанное
+#else
+    #define FLASH_PREFETCH      0
+#endif
+
+#if (_FLASH_FAMILY == 0)
+    #define FLASH_IS_AT45(dev)      ((dev)->Family == FLASH_FAMILY_AT45)        // семейство - по опознанной м/сх
+    #define FLASH_IS_NOR(dev)       ((dev)->Family == FLASH_FAMILY_NOR)
+#else
+    #define FLASH_IS_AT45(dev)      (_FLASH_FAMILY == FLASH_FAMILY_AT45)        // семейство задано при сборке: условие постоянное, ветви другого семейства выбрасывает компилятор
+    #define FLASH_IS_NOR(dev)       (_FLASH_FAMILY == FLASH_FAMILY_NOR)
+#endif
+#if (_FLASH_PG_SHIFT == 0)
+    #define FLASH_PGSIZE(dev)       ((dev)->PgSize)                             // геометрия - по опознанной м/сх
+    #define FLASH_SHIFT(dev)        ((dev)->Shift)
+    #define FLASH_LINEAR(dev)       ((dev)->Linear)
+#else
+    #define FLASH_PGSIZE(dev)       (1u << _FLASH_PG_SHIFT)                     // страница задана при сборке: деления и умножения на её размер - сдвиги
+    #define FLASH_SHIFT(dev)        (_FLASH_PG_SHIFT)
+    #define FLASH_LINEAR(dev)       true                                        // адрес команды = линейный адрес
+#endif
+
+#if (_FLASH_USE_STATS == 1)
+#ifndef _FLASH_CYCLES
+    #define _FLASH_CYCLES_INIT()            (CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk, DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk)  // запуск счётчика тактов DWT
+    #define _FLASH_CYCLES()                 (DWT->CYCCNT)                       // счётчик тактов ядра
+    #define _FLASH_CYCLES_PER_US            (SystemCoreClock / 1000000u)
+#endif
+    #define FLASH_STAT_BEGIN(t)             uint32_t t = _FLASH_CYCLES ()       // начало измеряемой операции
+    #define FLASH_STAT_END(op, t, bytes)    Flash_StatAdd (op, t, bytes)        // конец измеряемой операции
+    #define FLASH_STAT_INC(field)           (flashStats.field++)                // счётчик событий
+#else
+    #define FLASH_STAT_BEGIN(t)                                                 // инструментирование отключено: макросы пустые
+    #define FLASH_STAT_END(op, t, bytes)
+    #define FLASH_STAT_INC(field)
+#endif
 
-void Flash_ChipSelect       (bool available)                                    // функция запрета/разрешения работы с м/сх памяти
+#if (_FLASH_USE_QSPI == 1)
+FLASH_t          flash = FLASH_DEVICE (&_FLASH_QSPI, _FLASH_CS_GPIO, _FLASH_CS_PIN,  // устройство по умолчанию: м/сх на QUADSPI
+                                       _FLASH_WP_GPIO, _FLASH_WP_PIN, _FLASH_RST_GPIO, _FLASH_RST_PIN);
+#else
+FLASH_t          flash = FLASH_DEVICE (&_FLASH_SPI, _FLASH_CS_GPIO, _FLASH_CS_PIN,   // устройство по умолчанию: м/сх на _FLASH_SPI
+                                       _FLASH_WP_GPIO, _FLASH_WP_PIN, _FLASH_RST_GPIO, _FLASH_RST_PIN);
+#endif
+
+static FLASH_t  *flashDevs[_FLASH_DEVICES];                                     // инициализированные м/сх: поиск по шине в обработчике DMA, обход в таймере простоя
+
+#if (_FLASH_USE_FREERTOS == 1 && _FLASH_IDLE_MS > 0)
+    static TimerHandle_t     flashIdleTimer;                                    // периодический таймер проверки простоя всех м/сх
+    static void Flash_IdleTimer (TimerHandle_t timer);
+#endif
+
+// ------------------------------- Статистика операций: -----------------------------------------------------------------------------
+
+#if (_FLASH_USE_STATS == 1)
+static FLASH_Stats_t        flashStats;                                         // счётчики и гистограммы операций
+
+static void Flash_StatAdd   (uint8_t op, uint32_t start, uint32_t bytes)        // функция учёта завершённой операции: задержка по счётчику тактов от start
 {
-    if (available)
-        HAL_GPIO_WritePin   (_FLASH_CS_GPIO, _FLASH_CS_PIN, GPIO_PIN_RESET);    // разрешение работы с м/сх памяти
-    else
-        HAL_GPIO_WritePin   (_FLASH_CS_GPIO, _FLASH_CS_PIN, GPIO_PIN_SET);      // запрет работы с м/сх памяти
+    FLASH_OpStats_t *st     = &flashStats.Op[op];
+    uint32_t  us            = (_FLASH_CYCLES () - start) / _FLASH_CYCLES_PER_US;
+    uint8_t   bucket        = 0;                                                // корзина гистограммы: [2^i, 2^(i+1)) мкс
+    while (bucket < FLASH_STAT_BUCKETS - 1 && (us >> (bucket + 1)))
+        bucket++;
+    _FLASH_IRQ_OFF          ();                                                 // Flash_EraseRange учитывается вне захвата м/сх
+    st->Count++;
+    st->Bytes              += bytes;
+    st->TotalUs            += us;
+    if (us > st->MaxUs)
+        st->MaxUs           = us;
+    st->Hist[bucket]++;
+    _FLASH_IRQ_ON           ();
 }
+#endif
 
-void Flash_WriteEnable      (bool available)                                    // функция запрета/разрешения записи в м/сх памяти
+static inline bool Flash_HalOk (HAL_StatusTypeDef status)                       // функция проверки результата вызова HAL (с учётом ошибок в статистике)
 {
-    if (available)
-        HAL_GPIO_WritePin   (_FLASH_WP_GPIO, _FLASH_WP_PIN, GPIO_PIN_RESET);    // аппаратное разрешение записи в м/сх памяти
-    else
-        HAL_GPIO_WritePin   (_FLASH_WP_GPIO, _FLASH_WP_PIN, GPIO_PIN_SET);      // аппаратный запрет записи в м/сх памяти
+#if (_FLASH_USE_STATS == 1)
+    if (status == HAL_TIMEOUT)
+        flashStats.HalTimeouts++;
+    else if (status != HAL_OK)
+        flashStats.HalErrors++;
+#endif
+    return status == HAL_OK;
 }
 
-void Flash_Reset            (void)                                              // функция аппаратного сброса м/сх памяти
+bool Flash_GetStats         (FLASH_Stats_t *stats)                              // функция получения копии статистики операций (false -> статистика не компилируется)
 {
-    HAL_GPIO_WritePin   (_FLASH_RST_GPIO, _FLASH_RST_PIN, GPIO_PIN_RESET);      // активация аппаратного сброса м/сх памяти
-    _FLASH_DELAY        (DELAY);
-    HAL_GPIO_WritePin   (_FLASH_RST_GPIO, _FLASH_RST_PIN, GPIO_PIN_SET);        // деактивация аппаратного сброса м/сх памяти
+#if (_FLASH_USE_STATS == 1)
+    _FLASH_IRQ_OFF          ();                                                 // согласованная копия: счётчики меняются и в других задачах
+    *stats                  = flashStats;
+    _FLASH_IRQ_ON           ();
+    return true;
+#else
+    (void)stats;
+    return false;
+#endif
 }
 
-bool Flash_Init             (void)                                              // функция инициализации микросхемы flash-памяти
+void Flash_ResetStats       (void)                                              // функция обнуления статистики операций
 {
-    flash.Busy              = true;                                             // установка флага занятости м/сх памяти
-    flash.Id                = 0;                                                // подготовка переменной для номера-идентификатора м/сх памяти. 0 -> м/сх не опознана, 1-255 -> м/сх идентифицирована
-    uint32_t Id             = 0;
-    Flash_Reset             ();                                                 // аппаратный сброс м/сх памяти
-    Flash_ChipSelect        (false);                                            // подготовка после включения
-    while (HAL_GetTick() < 20)                                                  // обеспечение принудительной задержки перед инициализацией м/сх
-        _FLASH_DELAY        (DELAY/10);
-    Flash_ChipSelect        (true);                                             // разрешение работы с м/сх памяти
-    Flash_Spi               (FLASH_GET_JEDEC_ID);                               // отправка команды: 0x9F - "считывание идентификатора производителя и устройства"
-    uint8_t  mnfId          = Flash_Spi(DUMMY_BYTE);                            // чтение Manufacturer ID
-    Id                      = Id | (Flash_Spi(DUMMY_BYTE) << 24);               // чтение Device ID Byte 1
-    Id                      = Id | (Flash_Spi(DUMMY_BYTE) << 16);               // чтение Device ID Byte 2
-    Id                      = Id | (Flash_Spi(DUMMY_BYTE) << 8);                // чтение Extended Device Information String Length
-    Id                      = Id |  Flash_Spi(DUMMY_BYTE);                      // чтение Extended Device Information Byte 1
-    Flash_ChipSelect        (false);                                            // завершение работы с м/сх памяти
-
-    if (mnfId == AT45_ADESTO)                                                   // когда идентификатор производителя =0x1F (ADESTO/ATMEL)  ->
-    {
-        switch (Id)                                                             // идентификация м/сх памяти ->
-        {
-            case 0x22000000:                                                    // at45db011d - 1Mbit/128Kb
-                flash.Pages = 512;                                              // общее количество страниц памяти на м/сх
-                flash.PgSize= 264;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 9;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 1;                                                // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+#if (_FLASH_USE_STATS == 1)
+    _FLASH_IRQ_OFF          ();
+    memset                  (&flashStats, 0, sizeof (flashStats));
+    _FLASH_IRQ_ON           ();
+#endif
+}
 
-            case 0x22000001:                                                    // at45db011d - 1Mbit/128Kb
-                flash.Pages = 512;                                              // общее количество страниц памяти на м/сх
-                flash.PgSize= 256;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 8;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 2;                                                // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+uint32_t Flash_StatsSnapshot (uint8_t *buf, uint32_t size)                      // функция упаковки статистики в двоичный снимок для телеметрии
+{                                                                               // формат (младшим байтом вперёд): 'F', 'S', версия, число операций N,
+#if (_FLASH_USE_STATS == 1)                                                     // N x { Count:4, Bytes:4, TotalUs:8, MaxUs:4, Hist:2 x FLASH_STAT_BUCKETS (с насыщением) },
+    FLASH_Stats_t st;                                                           // BusyPolls:4, Wakeups:4, HalErrors:4, HalTimeouts:4
+    uint32_t  need          = 4 + FLASH_STAT_OPS * (20 + 2 * FLASH_STAT_BUCKETS) + 16;
+    if (buf == NULL || size < need)                                             // буфер мал -> ничего не пишется
+        return 0;
+    Flash_GetStats          (&st);
+    uint8_t  *p             = buf;
+    *p++                    = 'F';
+    *p++                    = 'S';
+    *p++                    = FLASH_STATS_VERSION;
+    *p++                    = FLASH_STAT_OPS;
+    #define FLASH_PUT(v, n) do { uint64_t _v = (v); for (uint8_t _i = 0; _i < (n); _i++, _v >>= 8) *p++ = (uint8_t)_v; } while (0)
+    for (uint8_t i = 0; i < FLASH_STAT_OPS; i++)
+    {
+        FLASH_PUT           (st.Op[i].Count,   4);
+        FLASH_PUT           (st.Op[i].Bytes,   4);
+        FLASH_PUT           (st.Op[i].TotalUs, 8);
+        FLASH_PUT           (st.Op[i].MaxUs,   4);
+        for (uint8_t b = 0; b < FLASH_STAT_BUCKETS; b++)
+            FLASH_PUT       (st.Op[i].Hist[b] > 0xFFFF ? 0xFFFF : st.Op[i].Hist[b], 2);
+    }
+    FLASH_PUT               (st.BusyPolls,   4);
+    FLASH_PUT               (st.Wakeups,     4);
+    FLASH_PUT               (st.HalErrors,   4);
+    FLASH_PUT               (st.HalTimeouts, 4);
+    #undef FLASH_PUT
+    return (uint32_t)(p - buf);
+#else
+    (void)buf;
+    (void)size;
+    return 0;
+#endif
+}
 
-            case 0x23000100:                                                    // at45db021e - 2Mbit/256Kb
-                flash.Pages = 1024;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 264;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 9;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 3;                                                // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+// ------------------------------- Базовые функции для работы с м/сх FLASH-памяти: -----------------------------------------------------
 
-            case 0x23000101:                                                    // at45db021e - 2Mbit/256Kb
-                flash.Pages = 1024;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 256;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 8;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 4;                                                // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+#if (FLASH_PREFETCH == 1)
+static void Flash_PrefetchSettle (FLASH_t *own);
+#endif
+static bool Flash_MutexInit (FLASH_t *own);
 
-            case 0x24000100:                                                    // at45db041e - 4Mbit/512Kb
-                flash.Pages = 2048;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 264;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 9;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 5;                                                // уникальный номер-идентификатор м/сх (для внутренних нужд)
+static void Flash_Lock      (FLASH_t *dev)                                      // функция захвата м/сх памяти задачей
+{                                                                               // м/сх на общей шине захватывают мьютекс владельца шины
+    FLASH_t  *own           = dev->BusOwner ? dev->BusOwner : dev;
+#if (_FLASH_USE_FREERTOS == 1)
+    xSemaphoreTake          ((SemaphoreHandle_t)own->Mutex, portMAX_DELAY);     // задача спит, пока м/сх занята другой задачей; владелец наследует её приоритет
+#else
+    for (;;)                                                                    // без ОС: атомарная проверка и установка флага занятости
+    {
+        _FLASH_IRQ_OFF      ();
+        bool      taken     = !own->Busy;
+        own->Busy           = true;
+        _FLASH_IRQ_ON       ();
+        if (taken)
             break;
+    }
+#endif
+#if (FLASH_PREFETCH == 1)
+    Flash_PrefetchSettle    (own);                                              // на шине идёт упреждающее чтение -> его приём завершается первым
+#endif
+    dev->Busy               = true;                                             // установка флага занятости м/сх памяти
+}
 
-            case 0x24000101:                                                    // at45db041e - 4Mbit/512Kb
-                flash.Pages = 2048;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 256;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 8;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 6;                                                // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+static void Flash_Unlock    (FLASH_t *dev)                                      // функция освобождения м/сх памяти
+{
+    FLASH_t  *own           = dev->BusOwner ? dev->BusOwner : dev;
+    dev->LastAccess         = _FLASH_TICK ();                                   // отсчёт простоя - от последнего обращения
+    dev->Busy               = false;                                            // установка флага готовности м/сх памяти
+    own->Busy               = false;
+#if (_FLASH_USE_FREERTOS == 1)
+    xSemaphoreGive          ((SemaphoreHandle_t)own->Mutex);
+#endif
+}
 
-            case 0x25000000:                                                    // at45db081d - 8Mbit/1Mb
-                flash.Pages = 4096;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 264;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 9;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 7;                                                // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+void Flash_ChipSelect       (FLASH_t *dev, bool available)                      // функция запрета/разрешения работы с м/сх памяти
+{
+#if (_FLASH_USE_QSPI == 1)
+    (void)dev;
+    (void)available;                                                            // QUADSPI управляет выводом NCS самостоятельно
+#else
+    _FLASH_PIN              (dev->CsGpio, dev->CsPin, !available);              // низкий уровень - разрешение, высокий - запрет работы с м/сх памяти
+#endif
+}
 
-            case 0x25000001:                                                    // at45db081d - 8Mbit/1Mb
-                flash.Pages = 4096;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 256;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 8;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 8;                                                // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+void Flash_WriteEnable      (FLASH_t *dev, bool available)                      // функция запрета/разрешения записи в м/сх памяти
+{
+    if (dev->Lines != 4)                                                        // Quad I/O: вывод /WP - линия данных IO2, им управляет QUADSPI
+        _FLASH_PIN          (dev->WpGpio, dev->WpPin, !available);              // низкий уровень - аппаратное разрешение, высокий - запрет записи в м/сх памяти
+}
 
-            case 0x25000100:                                                    // at45db081e - 8Mbit/1Mb
-                flash.Pages = 4096;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 264;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 9;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 9;                                                // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+static bool Flash_Register  (FLASH_t *dev)                                      // функция внесения м/сх в список инициализированных (false -> список заполнен)
+{
+    _FLASH_IRQ_OFF          ();                                                 // список читается из прерывания DMA
+    FLASH_t **slot          = NULL;
+    for (uint8_t i = 0; i < _FLASH_DEVICES; i++)
+    {
+        if (flashDevs[i] == dev)                                                // повторная инициализация
+        {
+            _FLASH_IRQ_ON   ();
+            return true;
+        }
+        if (flashDevs[i] == NULL && slot == NULL)
+            slot            = &flashDevs[i];
+    }
+    if (slot)
+        *slot               = dev;
+    _FLASH_IRQ_ON           ();
+    return slot != NULL;
+}
 
-            case 0x25000101:                                                    // at45db081e - 8Mbit/1Mb
-                flash.Pages = 4096;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 256;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 8;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 10;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
 
-            case 0x26000000:                                                    // at45db161d - 16Mbit/2Mb
-                flash.Pages = 4096;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 528;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 10;                                               // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 11;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+#if (_FLASH_USE_DMA == 1)
+void Flash_DmaComplete      (void *handle, bool ok)                             // функция-обработчик завершения DMA-передачи (вызывается из прерывания)
+{                                                                               // адресат - м/сх, которая ждёт DMA на этой шине; при _FLASH_DMA_CALLBACKS = 0 её вызывают
+                                                                                // обработчики HAL приложения, иначе приём по DMA завершается только по таймауту
+    FLASH_t  *dev           = NULL;
+    for (uint8_t i = 0; i < _FLASH_DEVICES && dev == NULL; i++)
+        if (flashDevs[i] && flashDevs[i]->Bus == handle && flashDevs[i]->DmaWait)
+            dev             = flashDevs[i];
+    if (dev == NULL)                                                            // событие от другого интерфейса -> не наше
+        return;
+    dev->DmaWait            = false;
+    dev->DmaStatus          = ok ? HAL_OK : HAL_ERROR;                          // сохранение результата передачи
+#if (_FLASH_USE_FREERTOS == 1)
+    BaseType_t woken        = pdFALSE;
+    xSemaphoreGiveFromISR   ((SemaphoreHandle_t)dev->DmaDone, &woken);          // пробуждение ожидающей задачи
+    portYIELD_FROM_ISR      (woken);
+#else
+    dev->DmaFlag            = true;                                             // установка флага завершения передачи
+#endif
+}
 
-            case 0x26000001:                                                    // at45db161d - 16Mbit/2Mb
-                flash.Pages = 8192;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 512;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 9;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 12;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+#if (_FLASH_DMA_CALLBACKS == 1)
+#if (_FLASH_USE_QSPI == 1)
+void HAL_QSPI_RxCpltCallback (QSPI_HandleTypeDef *hqspi)                        // обработчик HAL: приём по DMA завершён
+{
+    Flash_DmaComplete       (hqspi, true);
+}
 
-            case 0x26000100:                                                    // at45db161e - 16Mbit/2Mb
-                flash.Pages = 4096;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 528;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 10;                                               // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 13;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+void HAL_QSPI_ErrorCallback (QSPI_HandleTypeDef *hqspi)                         // обработчик HAL: ошибка QUADSPI
+{
+    Flash_DmaComplete       (hqspi, false);
+}
+#else
+void HAL_SPI_RxCpltCallback (SPI_HandleTypeDef *hspi)                           // обработчик HAL: приём по DMA завершён
+{
+    Flash_DmaComplete       (hspi, true);
+}
 
-            case 0x26000101:                                                    // at45db161e - 16Mbit/2Mb
-                flash.Pages = 8192;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 512;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 9;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 14;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+void HAL_SPI_ErrorCallback  (SPI_HandleTypeDef *hspi)                           // обработчик HAL: ошибка SPI
+{
+    Flash_DmaComplete       (hspi, false);
+}
+#endif
+#endif
 
-            case 0x27000000:                                                    // at45db321d - 32Mbit/4Mb
-                flash.Pages = 8192;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 528;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 10;                                               // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 15;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+static bool Flash_DmaPrepare (FLASH_t *dev)                                     // функция подготовки к ожиданию завершения DMA-передачи
+{
+#if (_FLASH_USE_FREERTOS == 1)
+    if (dev->DmaDone == NULL)                                                   // ленивое создание семафора завершения
+        dev->DmaDone        = xSemaphoreCreateBinary ();
+    if (dev->DmaDone == NULL)
+        return false;
+#else
+    dev->DmaFlag            = false;
+#endif
+    dev->DmaWait            = true;                                             // с этого момента прерывание DMA адресовано этой м/сх
+    return true;
+}
 
-            case 0x27000001:                                                    // at45db321d - 32Mbit/4Mb
-                flash.Pages = 8192;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 512;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 9;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 16;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+static HAL_StatusTypeDef Flash_DmaWait (FLASH_t *dev, uint32_t timeout)         // функция ожидания завершения запущенной DMA-передачи
+{
+#if (_FLASH_USE_FREERTOS == 1)
+    if (xSemaphoreTake ((SemaphoreHandle_t)dev->DmaDone, pdMS_TO_TICKS (timeout)) != pdTRUE)  // задача спит до прерывания завершения DMA
+#else
+    uint32_t start          = _FLASH_TICK ();
+    while (!dev->DmaFlag && (_FLASH_TICK () - start) < timeout);                // ожидание завершения передачи
+    if (!dev->DmaFlag)
+#endif
+    {
+        dev->DmaWait        = false;
+#if (_FLASH_USE_QSPI == 1)
+        HAL_QSPI_Abort      ((QSPI_HandleTypeDef*)dev->Bus);                    // передача зависла -> принудительный останов
+#else
+        _FLASH_SPI_ABORT    (dev->Bus);                                         // передача зависла -> принудительный останов
+#endif
+        return HAL_TIMEOUT;
+    }
+    return (HAL_StatusTypeDef)dev->DmaStatus;
+}
+#endif
 
-            case 0x27010100:                                                    // at45db321e - 32Mbit/4Mb
-                flash.Pages = 8192;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 528;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 10;                                               // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 17;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+#if (_FLASH_USE_QSPI == 1)
+static uint32_t Flash_QspiLines (uint8_t lines, uint32_t one, uint32_t two, uint32_t four)  // функция выбора режима фазы QUADSPI по количеству линий
+{
+    return lines == 4 ? four : lines == 2 ? two : one;
+}
 
-            case 0x27010101:                                                    // at45db321e - 32Mbit/4Mb
-                flash.Pages = 8192;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 512;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 9;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 18;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+bool Flash_Xfer             (FLASH_t *dev, const FLASH_Xfer_t *x)               // функция выполнения транзакции по её описанию (QUADSPI: Chip Select управляется периферией)
+{                                                                               // вся транзакция - одна команда QUADSPI, фазы адреса и данных - на 1, 2 или 4 линиях
+    QSPI_CommandTypeDef c   = {0};
+    c.InstructionMode       = QSPI_INSTRUCTION_1_LINE;                          // команда всегда по одной линии
+    c.Instruction           = x->Cmd;
+    c.AddressMode           = x->AddrLen ? Flash_QspiLines (x->AddrLines, QSPI_ADDRESS_1_LINE, QSPI_ADDRESS_2_LINES, QSPI_ADDRESS_4_LINES) : QSPI_ADDRESS_NONE;
+    c.AddressSize           = x->AddrLen == 4 ? QSPI_ADDRESS_32_BITS : QSPI_ADDRESS_24_BITS;
+    c.Address               = x->Addr;
+    c.AlternateByteMode     = x->ModeLen ? Flash_QspiLines (x->AddrLines, QSPI_ALTERNATE_BYTES_1_LINE, QSPI_ALTERNATE_BYTES_2_LINES, QSPI_ALTERNATE_BYTES_4_LINES) : QSPI_ALTERNATE_BYTES_NONE;
+    c.AlternateBytesSize    = QSPI_ALTERNATE_BYTES_8_BITS;                      // байт режима (M7-M0) после адреса
+    c.AlternateBytes        = x->Mode;
+    c.DummyCycles           = x->DummyCycles;
+    c.DataMode              = x->Dir == FLASH_DIR_NONE ? QSPI_DATA_NONE : Flash_QspiLines (x->DataLines, QSPI_DATA_1_LINE, QSPI_DATA_2_LINES, QSPI_DATA_4_LINES);
+    c.NbData                = x->Len;
+    c.DdrMode               = QSPI_DDR_MODE_DISABLE;
+    c.DdrHoldHalfCycle      = QSPI_DDR_HHC_ANALOG_DELAY;
+    c.SIOOMode              = QSPI_SIOO_INST_EVERY_CMD;
+    if (dev->Bus == NULL || x->Hold || !Flash_HalOk (HAL_QSPI_Command ((QSPI_HandleTypeDef*)dev->Bus, &c, _FLASH_TIMEOUT (0))))  // продолжение фазы данных вызывающей функцией QUADSPI не поддерживает
+        return false;
+    if (x->Dir == FLASH_DIR_TX)
+        return Flash_HalOk (HAL_QSPI_Transmit ((QSPI_HandleTypeDef*)dev->Bus, x->Buf, _FLASH_TIMEOUT (x->Len)));
+    if (x->Dir == FLASH_DIR_RX)
+    {
+#if (_FLASH_USE_DMA == 1)
+        if (x->Len >= _FLASH_DMA_MIN)                                           // длинный приём -> DMA, процессор свободен
+            return Flash_DmaPrepare (dev) && Flash_HalOk (HAL_QSPI_Receive_DMA ((QSPI_HandleTypeDef*)dev->Bus, x->Buf)) &&
+                   Flash_HalOk (Flash_DmaWait (dev, _FLASH_TIMEOUT (x->Len)));
+#endif
+        return Flash_HalOk (HAL_QSPI_Receive ((QSPI_HandleTypeDef*)dev->Bus, x->Buf, _FLASH_TIMEOUT (x->Len)));
+    }
+    return true;
+}
+#else
+static bool Flash_XferData  (FLASH_t *dev, uint8_t dir, uint8_t *buf, uint32_t len)  // функция фазы данных транзакции: непрерывный обмен порциями не более _FLASH_XFER_MAX
+{
+    bool                    ok = true;
+    while (ok && len)
+    {
+        uint16_t  chunk     = len > _FLASH_XFER_MAX ? _FLASH_XFER_MAX : len;
+        if (dir == FLASH_DIR_TX)
+            ok              = Flash_HalOk (_FLASH_SPI_TX (dev->Bus, buf, chunk, _FLASH_TIMEOUT (chunk)));
+#if (_FLASH_USE_DMA == 1)
+        else if (chunk >= _FLASH_DMA_MIN)                                       // длинный приём -> DMA, процессор свободен
+            ok              = Flash_DmaPrepare (dev) && Flash_HalOk (_FLASH_SPI_RX_DMA (dev->Bus, buf, chunk)) &&
+                              Flash_HalOk (Flash_DmaWait (dev, _FLASH_TIMEOUT (chunk)));
+#endif
+        else
+            ok              = Flash_HalOk (_FLASH_SPI_RX (dev->Bus, buf, chunk, _FLASH_TIMEOUT (chunk)));
+        buf                += chunk;
+        len                -= chunk;
+    }
+    return ok;
+}
 
-            case 0x28000000:                                                    // at45db642d - 64Mbit/8Mb
-                flash.Pages = 8192;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 1056;                                             // размер одной страницы памяти в байтах
-                flash.Shift = 11;                                               // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 19;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+bool Flash_Xfer             (FLASH_t *dev, const FLASH_Xfer_t *x)               // функция выполнения транзакции по её описанию в пределах одного Chip Select
+{                                                                               // команда, адрес и фиктивные байты уходят одной посылкой HAL, короткий ответ принимается в ней же
+    uint8_t   tx[_FLASH_FRAME_MAX];                                             // кадр: команда + адрес + байт режима + фиктивные байты (+ короткие данные)
+    uint8_t   rx[_FLASH_FRAME_MAX];                                             // ответ м/сх на кадр
+    uint32_t  n             = 0;
+    bool      ok;
+    if (dev->Bus == NULL || x->AddrLines > 1 || x->DataLines > 1)               // виртуальное устройство без своей шины; обычный SPI: только одна линия данных в каждую сторону
+        return false;
+    tx[n++]                 = x->Cmd;                                           // байт команды
+    for (uint8_t i = x->AddrLen; i; i--)                                        // байты адреса, старшим байтом вперёд
+        tx[n++]             = (uint8_t)(x->Addr >> ((i - 1) * 8));
+    if (x->ModeLen)                                                             // байт режима
+        tx[n++]             = x->Mode;
+    for (uint8_t i = 0; i < x->DummyCycles / 8; i++)                            // фиктивные байты: 8 тактов каждый
+        tx[n++]             = DUMMY_BYTE;
+    bool      inFrame       = x->Dir == FLASH_DIR_NONE || x->Len <= sizeof (tx) - n;  // фаза данных помещается в кадр
+    if (inFrame && x->Dir != FLASH_DIR_NONE)
+    {
+        if (x->Dir == FLASH_DIR_TX)
+            memcpy          (&tx[n], x->Buf, x->Len);                           // короткие данные на запись дописываются в кадр
+        else
+            memset          (&tx[n], DUMMY_BYTE, x->Len);                       // на время приёма передаются фиктивные байты
+    }
+    Flash_ChipSelect        (dev, true);                                        // разрешение работы с м/сх памяти
+    if (inFrame && x->Dir == FLASH_DIR_RX)
+    {
+        ok                  = Flash_HalOk (_FLASH_SPI_TXRX (dev->Bus, tx, rx, n + x->Len, _FLASH_TIMEOUT (n + x->Len)));
+        memcpy              (x->Buf, &rx[n], x->Len);                           // выдача принятого ответа
+    }
+    else
+    {
+        ok                  = Flash_HalOk (_FLASH_SPI_TX (dev->Bus, tx, inFrame ? n + x->Len : n, _FLASH_TIMEOUT (n + x->Len)));
+        if (ok && !inFrame)                                                     // длинная фаза данных -> отдельный непрерывный обмен в том же Chip Select
+            ok              = Flash_XferData (dev, x->Dir, x->Buf, x->Len);
+    }
+    if (!x->Hold || !ok)                                                        // Hold: фазу данных продолжает вызывающая функция
+        Flash_ChipSelect    (dev, false);                                       // завершение работы с м/сх памяти
+    return ok;
+}
+#endif
 
-            case 0x28000001:                                                    // at45db642d - 64Mbit/8Mb
-                flash.Pages = 8192;                                             // общее количество страниц памяти на м/сх
-                flash.PgSize= 1024;                                             // размер одной страницы памяти в байтах
-                flash.Shift = 10;                                               // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 20;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+static bool Flash_Command   (FLASH_t *dev, uint8_t cmd)                         // функция отправки одиночной команды без операндов
+{
+    FLASH_Xfer_t x          = { .Cmd = cmd };
+    return Flash_Xfer       (dev, &x);
+}
 
-            case 0x28000100:                                                    // at45db641e - 64Mbit/8Mb
-                flash.Pages = 32768;                                            // общее количество страниц памяти на м/сх
-                flash.PgSize= 264;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 9;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 21;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+static bool Flash_WriteLatch(FLASH_t *dev)                                      // функция программного разрешения записи (для W25QXX перед каждым программированием/стиранием)
+{
+    return !FLASH_IS_NOR (dev) || Flash_Command (dev, W25_WREN);                // у AT45DBXXX программной защелки записи нет
+}
 
-            case 0x28000101:                                                    // at45db641e - 64Mbit/8Mb
-                flash.Pages = 32768;                                            // общее количество страниц памяти на м/сх
-                flash.PgSize= 256;                                              // размер одной страницы памяти в байтах
-                flash.Shift = 8;                                                // число фиктивных битов сдвига для вычисления абсолютного адреса
-                flash.Id    = 22;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+static uint32_t Flash_PageAddr (FLASH_t *dev, uint32_t page, uint32_t offset)   // функция вычисления адреса в формате команды м/сх по номеру страницы и смещению
+{                                                                               // AT45DBXXX: сдвиг на заданное количество бит, NOR: Shift = log2 (PgSize) -> линейный адрес
+    (void)dev;                                                                  // _FLASH_PG_SHIFT > 0: сдвиг постоянный, устройство не нужно
+    return (page << FLASH_SHIFT (dev)) + offset;
+}
 
-        }
-        flash.ErasableSize  = flash.PgSize;                                     // минимальный размер стираемого блока (только для LittleFS)
-        flash.NumOfErasable = flash.Pages;                                      // общее количество стираемых блоков   (только для LittleFS)
+static FLASH_Xfer_t Flash_ReadCmd (FLASH_t *dev, uint32_t devAddr)              // функция подготовки заголовка самой быстрой доступной команды чтения массива
+{
+    bool      addr4         = dev->AddrLen == 4;                                // м/сх больше 16 Мб: варианты команд с 4-байтным адресом
+    FLASH_Xfer_t x          = { .Cmd     = dev->Desc.ReadCmd,                   // 0x0B/0x0C - "непрерывное/быстрое чтение массива"
+                                .AddrLen = dev->AddrLen, .Addr = devAddr, .DummyCycles = dev->Desc.ReadDummy,
+                                .Dir     = FLASH_DIR_RX };
+    if (dev->Lines == 4)                                                        // 0xEB/0xEC - "быстрое чтение Quad I/O": адрес и данные по 4 линиям
+    {
+        x.Cmd               = addr4 ? W25_FAST_READ_QUAD_IO4 : W25_FAST_READ_QUAD_IO;
+        x.AddrLines         = 4;
+        x.ModeLen           = 1;                                                // M7-M0 = 0xFF: без режима непрерывного чтения
+        x.Mode              = 0xFF;
+        x.DummyCycles       = 4;
+        x.DataLines         = 4;
     }
-    else
-    if (mnfId == W25_WINBOND || mnfId == MX25_MACRONIX)                         // когда идентификатор производителя =0xEF (Winbond) или =0xC2 (Macronix) ->
+    else if (dev->Lines == 2)                                                   // 0x3B/0x3C - "быстрое чтение Dual Output": данные по 2 линиям
     {
-        switch ((Id & 0x00FF0000) >> 16)                                        // идентификация м/сх памяти ->
+        x.Cmd               = addr4 ? W25_FAST_READ_DUAL4 : W25_FAST_READ_DUAL;
+        x.DummyCycles       = 8;
+        x.DataLines         = 2;
+    }
+    return x;
+}
+
+static bool Flash_ReadArray (FLASH_t *dev, uint32_t devAddr, uint8_t *buf, uint32_t len)  // функция непрерывного чтения массива: один заголовок команды на весь массив
+{
+    FLASH_Xfer_t x          = Flash_ReadCmd (dev, devAddr);
+    x.Buf                   = buf;
+    x.Len                   = len;
+    return Flash_Xfer       (dev, &x);
+}
+
+static uint32_t Flash_SegLen (const FLASH_Seg_t *seg, uint8_t count)            // функция подсчёта общей длины сегментов
+{
+    uint32_t                len = 0;
+    for (uint8_t i = 0; i < count; i++)
+        len                += seg[i].Len;
+    return len;
+}
+
+static bool Flash_XferV     (FLASH_t *dev, FLASH_Xfer_t *x, const FLASH_Seg_t *seg, uint8_t count)  // функция транзакции, фаза данных которой собирается из сегментов
+{                                                                               // обычный SPI: заголовок и все сегменты - в одном Chip Select
+    bool                    ok = true;
+#if (_FLASH_USE_QSPI == 1)
+    for (uint8_t i = 0; ok && i < count; i++)                                   // QUADSPI продолжать фазу данных не умеет -> команда на сегмент, адрес сдвигается на его длину
+        if (seg[i].Len)
         {
-            case 0x11:                                                          // w25q10 - 1Mbit/128Kb
-                flash.Pages = 512;                                              // общее количество страниц памяти на м/сх
-                flash.Id    = 64;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+            x->Buf          = seg[i].Buf;
+            x->Len          = seg[i].Len;
+            ok              = Flash_Xfer (dev, x);
+            x->Addr        += seg[i].Len;
+        }
+#else
+    x->Buf                  = seg[0].Buf;                                       // только заголовок, Chip Select остаётся активным
+    x->Len                  = 0;
+    x->Hold                 = true;
+    if (!Flash_Xfer (dev, x))
+        return false;
+    for (uint8_t i = 0; ok && i < count; i++)
+        ok                  = Flash_XferData (dev, x->Dir, seg[i].Buf, seg[i].Len);
+    Flash_ChipSelect        (dev, false);                                       // завершение работы с м/сх памяти
+#endif
+    return ok;
+}
 
-            case 0x12:                                                          // w25q20 - 2Mbit/256Kb
-                flash.Pages = 1024;                                             // общее количество страниц памяти на м/сх
-                flash.Id    = 65;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+#if (_FLASH_USE_QSPI == 1)
+static void Flash_SetPending(FLASH_t *dev, uint8_t op, uint32_t page, uint32_t pages, uint32_t ms, uint32_t maxMs);
+static void Flash_WaitPending (FLASH_t *dev);
 
-            case 0x13:                                                          // w25q40 - 4Mbit/512Kb
-                flash.Pages = 2048;                                             // общее количество страниц памяти на м/сх
-                flash.Id    = 66;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+static bool Flash_SetQuadEnable (FLASH_t *dev)                                  // функция установки бита QE: выводы /WP и /HOLD становятся линиями данных IO2/IO3
+{
+    uint8_t   sr[2]         = {0};                                              // регистры состояния 1 и 2
+    bool      mx            = dev->Mnf == MX25_MACRONIX;                        // Macronix: QE - бит 6 регистра состояния, Winbond: бит 1 регистра состояния 2
+    uint8_t   qe            = mx ? MX25_SR_QE : W25_SR2_QE;
+    uint8_t  *reg           = mx ? &sr[0] : &sr[1];                             // регистр с битом QE
+    FLASH_Xfer_t rd1        = { .Cmd = W25_RDSR1, .Dir = FLASH_DIR_RX, .Buf = &sr[0], .Len = 1 };  // 0x05 - "считывание регистра состояния 1"
+    FLASH_Xfer_t rd2        = { .Cmd = W25_RDSR2, .Dir = FLASH_DIR_RX, .Buf = &sr[1], .Len = 1 };  // 0x35 - "считывание регистра состояния 2"
+    if (!Flash_Xfer (dev, &rd1) || (!mx && !Flash_Xfer (dev, &rd2)))
+        return false;
+    if (*reg & qe)                                                              // бит уже установлен (он энергонезависимый)
+        return true;
+    *reg                   |= qe;
+    FLASH_Xfer_t x          = { .Cmd = W25_WRSR1, .Dir = FLASH_DIR_TX, .Buf = sr, .Len = mx ? 1 : 2 };  // Winbond: оба регистра одной командой 0x01 (0x31 есть не у всех W25Q)
+    if (!Flash_WriteLatch (dev) || !Flash_Xfer (dev, &x))                       // 0x06 - "разрешение записи", 0x01 - "запись регистра состояния"
+        return false;
+    Flash_SetPending        (dev, FLASH_OP_PROGRAM, 0, 0, W25_TW_MS, W25_TW_MS);  // запись регистра состояния длится как программирование
+    Flash_WaitPending       (dev);
+    return Flash_Xfer (dev, mx ? &rd1 : &rd2) && (*reg & qe);                   // контроль: бит установлен
+}
+#endif
 
-            case 0x14:                                                          // w25q80 - 8Mbit/1Mb
-                flash.Pages = 4096;                                             // общее количество страниц памяти на м/сх
-                flash.Id    = 67;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+void Flash_Reset            (FLASH_t *dev)                                      // функция аппаратного сброса м/сх памяти
+{
+    _FLASH_PIN          (dev->RstGpio, dev->RstPin, false);                     // активация аппаратного сброса м/сх памяти
+    _FLASH_DELAY        (DELAY);
+    _FLASH_PIN          (dev->RstGpio, dev->RstPin, true);                      // деактивация аппаратного сброса м/сх памяти
+}
 
-            case 0x15:                                                          // w25q16 - 16Mbit/2Mb
-                flash.Pages = 8192;                                             // общее количество страниц памяти на м/сх
-                flash.Id    = 68;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+#define FLASH_TCE(pages, pgsize, msmb)  ((uint32_t)(((uint64_t)(pages) * (pgsize) * (msmb) + 0xFFFFF) >> 20))  // время стирания чипа по времени на мегабайт (с округлением вверх: не 0 у м/сх меньше 1 Мб)
 
-            case 0x16:                                                          // w25q32 - 32Mbit/4Mb
-                flash.Pages = 16384;                                            // общее количество страниц памяти на м/сх
-                flash.Id    = 69;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+#define FLASH_AT45(dev, id, pages, pgsize, shift, sect)                         /* описание м/сх AT45DBXXX: сектор -> блок (8 страниц) -> страница; */ \
+                                                                                /* приостановка операций - только у серии E (байт 3 ответа 0x9F = 1) */ \
+    { AT45_ADESTO, dev, 0xFFFFFFFF, id, FLASH_FAMILY_AT45, pgsize, pages, shift, 3, AT45_RDARRAYHF, 8, AT45_MNTHRUBF1, \
+      AT45_TEP_MS, AT45_TEP_MAX_MS, FLASH_TCE (pages, pgsize, AT45_TCE_MSMB), FLASH_TCE (pages, pgsize, AT45_TCE_MAX_MSMB), \
+      { { sect, AT45_SECTERASE, AT45_TSE_MS, AT45_TSE_MAX_MS }, \
+        { 8,    AT45_BLKERASE,  AT45_TBE_MS, AT45_TBE_MAX_MS }, \
+        { 1,    AT45_PGERASE,   AT45_TPE_MS, AT45_TPE_MAX_MS } }, \
+      ((dev) & 0x100) ? AT45_SUSPEND : 0, AT45_RESUME, AT45_TSUS_US }
 
-            case 0x17:                                                          // w25q64 - 64Mbit/8Mb
-                flash.Pages = 32768;                                            // общее количество страниц памяти на м/сх
-                flash.Id    = 70;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+#define FLASH_W25(cap, id, pages)                                               /* описание м/сх W25QXXX до 16 Мб: блок 64 Кб -> блок 32 Кб -> сектор 4 Кб */ \
+    { W25_WINBOND, (uint32_t)(cap) << 16, 0x00FF0000, id, FLASH_FAMILY_NOR, 256, pages, 8, 3, W25_FAST_READ, 8, W25_PP, \
+      W25_TPP_MS, W25_TPP_MAX_MS, FLASH_TCE (pages, 256, W25_TCE_MSMB), FLASH_TCE (pages, 256, W25_TCE_MAX_MSMB), \
+      { { 256, W25_BE,   W25_TBE_MS,   W25_TBE_MAX_MS   }, \
+        { 128, W25_BE32, W25_TBE32_MS, W25_TBE32_MAX_MS }, \
+        { 16,  W25_SE,   W25_TSE_MS,   W25_TSE_MAX_MS   } }, \
+      W25_SUSPEND, W25_RESUME, W25_TSUS_US }
 
-            case 0x18:                                                          // w25q128 - 128Mbit/16Mb
-                flash.Pages = 65536;                                            // общее количество страниц памяти на м/сх
-                flash.Id    = 71;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+#define FLASH_W25_4B(cap, id, pages)                                            /* описание м/сх W25QXXX больше 16 Мб: команды с 4-байтным адресом, 32 Кб блока среди них нет */ \
+    { W25_WINBOND, (uint32_t)(cap) << 16, 0x00FF0000, id, FLASH_FAMILY_NOR, 256, pages, 8, 4, W25_FAST_READ4, 8, W25_PP4, \
+      W25_TPP_MS, W25_TPP_MAX_MS, FLASH_TCE (pages, 256, W25_TCE_MSMB), FLASH_TCE (pages, 256, W25_TCE_MAX_MSMB), \
+      { { 256, W25_BE4,  W25_TBE_MS,   W25_TBE_MAX_MS   }, \
+        { 16,  W25_SE4,  W25_TSE_MS,   W25_TSE_MAX_MS   }, \
+        { 16,  W25_SE4,  W25_TSE_MS,   W25_TSE_MAX_MS   } }, \
+      W25_SUSPEND, W25_RESUME, W25_TSUS_US }
 
-            case 0x19:                                                          // w25q256 - 256Mbit/32Mb
-                flash.Pages = 131072;                                           // общее количество страниц памяти на м/сх
-                flash.Id    = 72;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
+static const FLASH_Desc_t flashParts[] =                                        // таблица известных м/сх: JEDEC ID -> геометрия, команды и времена операций
+{
+#if (_FLASH_FAMILY != 2)                                                        // сборка только для NOR -> строки AT45DBXXX не нужны
+    FLASH_AT45 (0x22000000,  1,    512,  264,  9,  128),                        // at45db011d - 1Mbit/128Kb
+    FLASH_AT45 (0x22000001,  2,    512,  256,  8,  128),                        // at45db011d - 1Mbit/128Kb, страница 2^n
+    FLASH_AT45 (0x23000100,  3,   1024,  264,  9,  128),                        // at45db021e - 2Mbit/256Kb
+    FLASH_AT45 (0x23000101,  4,   1024,  256,  8,  128),                        // at45db021e - 2Mbit/256Kb, страница 2^n
+    FLASH_AT45 (0x24000100,  5,   2048,  264,  9,  256),                        // at45db041e - 4Mbit/512Kb
+    FLASH_AT45 (0x24000101,  6,   2048,  256,  8,  256),                        // at45db041e - 4Mbit/512Kb, страница 2^n
+    FLASH_AT45 (0x25000000,  7,   4096,  264,  9,  256),                        // at45db081d - 8Mbit/1Mb
+    FLASH_AT45 (0x25000001,  8,   4096,  256,  8,  256),                        // at45db081d - 8Mbit/1Mb, страница 2^n
+    FLASH_AT45 (0x25000100,  9,   4096,  264,  9,  256),                        // at45db081e - 8Mbit/1Mb
+    FLASH_AT45 (0x25000101, 10,   4096,  256,  8,  256),                        // at45db081e - 8Mbit/1Mb, страница 2^n
+    FLASH_AT45 (0x26000000, 11,   4096,  528, 10,  256),                        // at45db161d - 16Mbit/2Mb
+    FLASH_AT45 (0x26000001, 12,   4096,  512,  9,  256),                        // at45db161d - 16Mbit/2Mb, страница 2^n
+    FLASH_AT45 (0x26000100, 13,   4096,  528, 10,  256),                        // at45db161e - 16Mbit/2Mb
+    FLASH_AT45 (0x26000101, 14,   4096,  512,  9,  256),                        // at45db161e - 16Mbit/2Mb, страница 2^n
+    FLASH_AT45 (0x27000000, 15,   8192,  528, 10,  128),                        // at45db321d - 32Mbit/4Mb
+    FLASH_AT45 (0x27000001, 16,   8192,  512,  9,  128),                        // at45db321d - 32Mbit/4Mb, страница 2^n
+    FLASH_AT45 (0x27010100, 17,   8192,  528, 10,  128),                        // at45db321e - 32Mbit/4Mb
+    FLASH_AT45 (0x27010101, 18,   8192,  512,  9,  128),                        // at45db321e - 32Mbit/4Mb, страница 2^n
+    FLASH_AT45 (0x28000000, 19,   8192, 1056, 11,  256),                        // at45db642d - 64Mbit/8Mb
+    FLASH_AT45 (0x28000001, 20,   8192, 1024, 10,  256),                        // at45db642d - 64Mbit/8Mb, страница 2^n
+    FLASH_AT45 (0x28000100, 21,  32768,  264,  9, 1024),                        // at45db641e - 64Mbit/8Mb
+    FLASH_AT45 (0x28000101, 22,  32768,  256,  8, 1024),                        // at45db641e - 64Mbit/8Mb, страница 2^n
+#endif
+#if (_FLASH_FAMILY != 1)                                                        // сборка только для AT45DBXXX -> строки NOR не нужны
+    FLASH_W25    (0x11, 64,    512),                                            // w25q10  - 1Mbit/128Kb
+    FLASH_W25    (0x12, 65,   1024),                                            // w25q20  - 2Mbit/256Kb
+    FLASH_W25    (0x13, 66,   2048),                                            // w25q40  - 4Mbit/512Kb
+    FLASH_W25    (0x14, 67,   4096),                                            // w25q80  - 8Mbit/1Mb
+    FLASH_W25    (0x15, 68,   8192),                                            // w25q16  - 16Mbit/2Mb
+    FLASH_W25    (0x16, 69,  16384),                                            // w25q32  - 32Mbit/4Mb
+    FLASH_W25    (0x17, 70,  32768),                                            // w25q64  - 64Mbit/8Mb
+    FLASH_W25    (0x18, 71,  65536),                                            // w25q128 - 128Mbit/16Mb
+    FLASH_W25_4B (0x19, 72, 131072),                                            // w25q256 - 256Mbit/32Mb
+    FLASH_W25_4B (0x20, 73, 262144),                                            // w25q512 - 512Mbit/64Mb
+#endif
+};
 
-            case 0x20:                                                          // w25q512 - 512Mbit/64Mb
-                flash.Pages = 262144;                                           // общее количество страниц памяти на м/сх
-                flash.Id    = 73;                                               // уникальный номер-идентификатор м/сх (для внутренних нужд)
-            break;
-        }
-        flash.PgSize        = 256;                                              // размер одной страницы памяти в байтах
-        flash.ErasableSize  = flash.PgSize << 4;                                // минимальный размер стираемого блока (только для LittleFS)
-        flash.NumOfErasable = flash.Pages  >> 4;                                // общее количество стираемых блоков   (только для LittleFS)
-        flash.Shift = 0;                                                        // число фиктивных битов сдвига для вычисления абсолютного адреса (для W25QXXX не используется)
-    }
-    else                                                                        // когда идентификатор производителя неизвестен -> продолжение работы с м/сх памяти не имеет смысла
-    {
-        flash.Busy          = true;                                             // установка флага занятостиготовности м/сх памяти
-        return false;                                                           // возврат неудачной инициализации м/сх
-    }
-    flash.Busy              = false;                                            // установка флага готовности м/сх памяти
-    return true;                                                                // возврат успешной инициализации м/сх
+static const FLASH_Desc_t *Flash_FindPart (uint8_t mnf, uint32_t devId)         // функция поиска м/сх в таблице известных м/сх
+{
+    for (uint32_t i = 0; i < sizeof (flashParts) / sizeof (flashParts[0]); i++)
+        if (flashParts[i].Mnf == mnf && (devId & flashParts[i].DevMask) == flashParts[i].DevId)
+            return &flashParts[i];
+    return NULL;
 }
 
-bool Flash_IsBusy           (void)                                              // функция ожидания готовности микросхемы Flash-памяти.
-{                                                                               // необходимость функции продиктована продолжительным процессом записи. для определения его окончания нужна эта функция.
-    uint16_t                status = 0;                                         // подготовка буфера для чтения регистра статуса м/сх памяти
-    bool                    isBusy = true;                                      // состояние занятости м/сх памяти: true -> м/сх памяти НЕ готова, false -> м/сх памяти готова для работы.
-    Flash_ChipSelect        (true);                                             // разрешение работы с м/сх
-    if (flash.Id < 64)                                                          // при работе с AT45DBXXX ->
-    {
-        Flash_Spi           (AT45_RDSR);                                        // отправка команды:    0xD7 - "считывание регистра состояния"
-        status              = Flash_Spi (DUMMY_BYTE);                           // чтение 1-го байта ответа от м/сх памяти
-        status              = status | (Flash_Spi (DUMMY_BYTE) << 8);           // чтение 2-го байта ответа от м/сх памяти
-        isBusy              = (status & AT45_SR_RDY) == 0;                      // определение занятости м/сх памяти
-    }
-    else                                                                        // при работе с W25QXX ->
+static uint8_t Flash_At45Status (FLASH_t *dev)                                  // функция чтения регистра состояния AT45DBXXX до заполнения описания м/сх
+{
+    uint8_t                 sr[2] = {0};
+    FLASH_Xfer_t x          = { .Cmd = AT45_RDSR, .Dir = FLASH_DIR_RX, .Buf = sr, .Len = sizeof (sr) };  // 0xD7 - "считывание регистра состояния"
+    Flash_Xfer              (dev, &x);
+    return sr[0];
+}
+
+static const FLASH_Desc_t *Flash_At45PageMode (FLASH_t *dev, const FLASH_Desc_t *d, uint32_t devId)  // функция выбора строки таблицы AT45DBXXX по фактическому размеру страницы
+{                                                                               // размер страницы задаёт бит PAGE_SIZE регистра состояния, а не ответ на 0x9F
+    uint8_t   sr            = Flash_At45Status (dev);
+#if (_FLASH_AT45_BINARY == 1)
+    if (!(sr & AT45_SR_PGSIZE))                                                 // страница "DataFlash" -> перевод на страницу 2^n байт
     {
-        Flash_Spi           (W25_RDSR1);                                        // отправка команды:    0x05 - "считывание регистра состояния 1"
-        status              = Flash_Spi (DUMMY_BYTE);                           // чтение регистра 1 состояния м/сх памяти
-        isBusy              = (status & W25_SR1S0) == 1;                        // определение занятости м/сх памяти
+        uint8_t  seq[3]     = { AT45_PGSIZE2, AT45_PGSIZE3, AT45_PGSIZE4_BIN }; // 0x3D, 0x2A, 0x80, 0xA6 - "выбор страницы 2^n байт"
+        FLASH_Xfer_t x      = { .Cmd = AT45_PGSIZE1, .Dir = FLASH_DIR_TX, .Buf = seq, .Len = sizeof (seq) };
+        Flash_WriteEnable   (dev, true);                                        // разрешение записи в память
+        Flash_Xfer          (dev, &x);
+        uint32_t  start     = _FLASH_TICK ();
+        while (!(Flash_At45Status (dev) & AT45_SR_RDY) &&                       // запись конфигурационного регистра длится как программирование страницы
+               _FLASH_TICK () - start <= AT45_TEP_MAX_MS)
+            _FLASH_DELAY    (1);
+        Flash_WriteEnable   (dev, false);                                       // запрет записи в память
+        sr                  = Flash_At45Status (dev);                           // серия D применяет новый размер только после выключения питания
     }
-    Flash_ChipSelect        (false);                                            // завершение работы с м/сх памяти
-    return (isBusy);                                                            // возврат состояния микросхемы памяти: true -> м/сх памяти занята, false -> м/сх памяти готова к приёму команд
+#endif
+    const FLASH_Desc_t *bin = Flash_FindPart (d->Mnf, (sr & AT45_SR_PGSIZE) ? devId | 1 : devId & ~1u);  // строки "DataFlash" и 2^n отличаются младшим битом
+    return bin ? bin : d;
 }
 
-void Flash_Resume           (void)                                              // функция пробуждения м/сх Flash-памяти после сна
+static uint32_t Flash_Le32  (const uint8_t *p)                                  // функция сборки 32-битного слова SFDP (младшим байтом вперёд)
 {
-    if (flash.Id)                                                               // когда м/сх памяти опознана ->
-    {
-        Flash_ChipSelect    (true);                                             // разрешение работы с м/сх
-        Flash_Spi           (FLASH_RESUME);                                     // отправка команды:    0xAB - "возобновление работы после сна"
-        Flash_ChipSelect    (false);                                            // завершение работы с м/сх памяти
-        while               (Flash_IsBusy ());                                  // ожидание готовности микросхемы Flash-памяти
-    }
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
 }
 
-void Flash_PowerDown        (void)                                              // функция усыпления м/сх Flash-памяти
+static uint32_t Flash_SfdpTime (uint32_t field, uint8_t countBits, const uint32_t *units)  // функция перевода поля времени SFDP (счётчик + единица) в мс
 {
-    if (flash.Id)                                                               // когда м/сх памяти опознана
-    {
-        Flash_ChipSelect    (true);                                             // разрешение работы с м/сх
-        Flash_Spi           (FLASH_PWRDOWN);                                    // отправка команды:    0xB9 - "усыпление микросхемы Flash-памяти"
-        Flash_ChipSelect    (false);                                            // завершение работы с м/сх памяти
-    }
+    return ((field & ((1u << countBits) - 1)) + 1) * units[field >> countBits];
 }
 
-void Flash_EraseChip        (void)                                              // функция стирания данных из м/сх Flash-памяти
+static bool Flash_Sfdp      (FLASH_t *dev, FLASH_Desc_t *d)                     // функция заполнения описания м/сх по основной таблице параметров SFDP (JESD216)
 {
-    if (flash.Id)                                                               // когда м/сх памяти опознана ->
+    static const uint32_t   eraseUnits[4] = { 1, 16, 128, 1000 };               // единицы времени стирания области (мс)
+    static const uint32_t   chipUnits[4]  = { 16, 256, 4000, 64000 };           // единицы времени стирания чипа (мс)
+    uint8_t   hdr[16];                                                          // заголовок SFDP + заголовок первой таблицы параметров
+    uint8_t   tbl[52]       = {0};                                              // DWORD1-DWORD13 основной таблицы параметров
+    FLASH_Xfer_t x          = { .Cmd = FLASH_READ_SFDP, .AddrLen = 3, .Addr = 0, .DummyCycles = 8,  // 0x5A - "чтение SFDP"
+                                .Dir = FLASH_DIR_RX, .Buf = hdr, .Len = sizeof (hdr) };
+    if (!Flash_Xfer (dev, &x) || Flash_Le32 (hdr) != FLASH_SFDP_SIGNATURE ||    // м/сх не поддерживает SFDP
+        hdr[8] != 0x00 || hdr[15] != 0xFF || hdr[11] < 9)                       // первая таблица - не основная (ID 0xFF00) или в ней нет описания стирания
+        return false;
+    x.Addr                  = Flash_Le32 (&hdr[12]) & 0x00FFFFFF;               // адрес основной таблицы
+    x.Buf                   = tbl;
+    x.Len                   = hdr[11] * 4u < sizeof (tbl) ? hdr[11] * 4u : sizeof (tbl);
+    if (!Flash_Xfer (dev, &x))
+        return false;
+    uint32_t  dw[13];
+    for (uint8_t i = 0; i < 13; i++)
+        dw[i]               = Flash_Le32 (&tbl[i * 4]);                         // непрочитанные слова остаются нулевыми
+    uint64_t  bytes         = (dw[1] & 0x80000000) ? ((dw[1] & 0x7FFFFFFF) < 40 ? (1ull << (dw[1] & 0x7FFFFFFF)) / 8 : 0)
+                                                   : ((uint64_t)dw[1] + 1) / 8; // DWORD2: объём м/сх в битах
+    uint8_t   addrMode      = (dw[0] >> 17) & 3;                                // DWORD1: 0 - адрес 3 байта, 1 - 3 или 4 байта, 2 - только 4 байта
+    if (addrMode != 2 && bytes > 0x1000000)                                     // коды команд с 4-байтным адресом у неизвестной м/сх не известны -> только первые 16 Мб
+        bytes               = 0x1000000;
+    memset                  (d, 0, sizeof (*d));
+    d->Mnf                  = dev->Mnf;
+    d->Id                   = FLASH_ID_SFDP;
+    d->Family               = FLASH_FAMILY_NOR;
+    d->Shift                = x.Len >= 44 ? (dw[10] >> 4) & 0x0F : 8;           // DWORD11: размер страницы 2^N байт
+    d->PgSize               = 1u << d->Shift;
+    d->Pages                = bytes >> d->Shift;
+    d->AddrLen              = addrMode == 2 ? 4 : 3;
+    d->ReadCmd              = W25_FAST_READ;                                    // 0x0B + 8 фиктивных тактов поддерживают все м/сх SFDP
+    d->ReadDummy            = 8;
+    d->ProgCmd              = W25_PP;
+    d->TppMs                = W25_TPP_MS;                                       // без DWORD11 - времена W25QXXX
+    d->TppMaxMs             = W25_TPP_MAX_MS;
+    d->TceMs                = FLASH_TCE (d->Pages, d->PgSize, W25_TCE_MSMB);
+    d->TceMaxMs             = FLASH_TCE (d->Pages, d->PgSize, W25_TCE_MAX_MSMB);
+    if (x.Len >= 44)                                                            // DWORD11: времена программирования страницы и стирания чипа
+    {
+        uint32_t  mult      = 2 * ((dw[10] & 0x0F) + 1);                        // множитель максимального времени
+        uint32_t  us        = Flash_SfdpTime ((dw[10] >> 8) & 0x3F, 5, (const uint32_t[]){ 8, 64 });
+        d->TppMs            = (us + 999) / 1000;
+        d->TppMaxMs         = (us * mult + 999) / 1000;
+        d->TceMs            = Flash_SfdpTime ((dw[10] >> 24) & 0x7F, 5, chipUnits);
+        d->TceMaxMs         = d->TceMs * mult;
+    }
+    if (x.Len >= 52 && !(dw[11] & 0x80000000))                                  // DWORD12-DWORD13: приостановка поддерживается (бит 31 = 0)
+    {
+        static const uint32_t   susUnits[4] = { 1, 1, 8, 64 };                  // единицы времени приостановки (мкс), 128 нс округлены вверх
+        uint32_t  us        = ((dw[11] >> 20 & 0x0F) + 1) * 64;                 // наименьший интервал от возобновления до приостановки
+        uint32_t  eraseUs   = Flash_SfdpTime ((dw[11] >> 24) & 0x7F, 5, susUnits);
+        uint32_t  progUs    = Flash_SfdpTime ((dw[11] >> 13) & 0x7F, 5, susUnits);
+        us                  = us > eraseUs ? us : eraseUs;
+        us                  = us > progUs ? us : progUs;
+        d->SuspendCmd       = dw[12] >> 24;                                     // команды приостановки/возобновления стирания (для программирования они те же)
+        d->ResumeCmd        = dw[12] >> 16;
+        d->TsusUs           = us > 0xFFFF ? 0xFFFF : us;
+    }
+    if (!d->Pages)
+        return false;
+    FLASH_Erase_t ops[4];                                                       // типы стирания, от крупного к мелкому
+    uint8_t   n             = 0;
+    for (uint8_t t = 0; t < 4; t++)                                             // DWORD8-DWORD9: размер 2^N байт и код команды для четырёх типов стирания
     {
-        while               (flash.Busy);                                       // ждём готовность м/сх памяти
-        flash.Busy          = true;                                             // установка флага занятости м/сх памяти
-        Flash_Resume        ();                                                 // пробуждение микросхемы памяти
-        Flash_ChipSelect    (true);                                             // разрешение работы с м/сх
-        Flash_WriteEnable   (true);                                             // разрешение записи в память
-        Flash_Spi           (FLASH_CHIP_ERASE);                                 // отправка команды:    0xC7 - "стирание чипа"
-    
-        if (flash.Id < 64)                                                      // особенности очистки чипа при работе с AT45DBXX ->
+        uint8_t   exp       = dw[7 + t / 2] >> (16 * (t & 1));
+        uint8_t   cmd       = dw[7 + t / 2] >> (16 * (t & 1) + 8);
+        if (!exp || exp < d->Shift || exp > 24)                                 // тип не поддерживается или меньше страницы
+            continue;
+        uint32_t  ms        = W25_TBE_MS, maxMs = W25_TBE_MAX_MS;               // без DWORD10 - времена 64 Кб блока W25QXXX
+        if (x.Len >= 40)                                                        // DWORD10: типовое время и множитель максимального
         {
-            Flash_Spi       (AT45_CHIPERASE2);                                  // отправка команды:    0x94 - "стирание чипа - байт 2"
-            Flash_Spi       (AT45_CHIPERASE3);                                  // отправка команды:    0x80 - "стирание чипа - байт 3"
-            Flash_Spi       (AT45_CHIPERASE4);                                  // отправка команды:    0x9A - "стирание чипа - байт 4"
+            ms              = Flash_SfdpTime ((dw[9] >> (4 + 7 * t)) & 0x7F, 5, eraseUnits);
+            maxMs           = ms * 2 * ((dw[9] & 0x0F) + 1);
         }
-    
-        Flash_ChipSelect    (false);                                            // завершение работы с м/сх памяти
-        while               (Flash_IsBusy ());                                  // ожидание готовности микросхемы памяти
-        Flash_WriteEnable   (false);                                            // запрет записи в память
-        flash.Busy          = false;                                            // установка флага готовности м/сх памяти
+        uint8_t   i         = n++;
+        for (; i && ops[i - 1].Pages < (1ul << (exp - d->Shift)); i--)          // вставка с сохранением порядка по убыванию размера
+            ops[i]          = ops[i - 1];
+        ops[i]              = (FLASH_Erase_t){ 1ul << (exp - d->Shift), cmd, ms > 0xFFFF ? 0xFFFF : ms, maxMs > 0xFFFF ? 0xFFFF : maxMs };
     }
+    if (!n)
+        return false;
+    if (n == 4)                                                                 // планировщику нужны три: самая крупная, следующая и самая мелкая
+        ops[2]              = ops[3];
+    for (uint8_t i = 0; i < 3; i++)                                             // недостающие варианты повторяют самый мелкий: не быстрее него -> не выбираются
+        d->Erase[i]         = ops[i < n ? i : n - 1];
+    return true;
 }
 
-void Flash_EraseArea        (uint32_t area)                                     // функция очистки указанной области на микросхеме Flash-памяти
-{
-    if (flash.Id)                                                               // когда м/сх памяти опознана ->
+// ------------------------------- Виртуальное устройство: чередование страниц двух м/сх ------------------------------------------------
+// страница N виртуального устройства - страница N/2 м/сх Stripe[N % 2], стираемый блок - блок с тем же номером на обеих м/сх.
+// соседние страницы лежат на разных м/сх: пока одна программирует или стирает, вторая принимает команду, а чтение
+// идёт по DMA на обеих шинах одновременно (м/сх на общей шине читаются по очереди).
+
+static void Flash_PrepareRead (FLASH_t *dev, uint32_t page, uint32_t pages);
+static void Flash_FinishRead (FLASH_t *dev);
+
+static bool Flash_ReadBegin (FLASH_t *dev, uint32_t page, uint32_t offset,      // функция запуска чтения массива: захват м/сх, заголовок команды и запуск приёма по DMA без ожидания
+                                           uint8_t *buf, uint32_t len, bool *dma)
+{                                                                               // *dma = true -> приём идёт, его завершает Flash_ReadEnd; иначе массив уже прочитан
+    bool                    ok;
+    uint32_t  devAddr       = Flash_PageAddr (dev, page, offset);
+    *dma                    = false;
+    Flash_Lock              (dev);                                              // захват м/сх памяти до Flash_ReadEnd
+    Flash_PrepareRead       (dev, page, (offset + len - 1) / FLASH_PGSIZE (dev) + 1);  // приостановка программирования/стирания других страниц или ожидание его завершения
+#if (_FLASH_USE_DMA == 1 && _FLASH_USE_QSPI == 0)
+    if (len >= _FLASH_DMA_MIN && len <= _FLASH_XFER_MAX)                        // длинный приём -> DMA: процессор свободен для запуска второй м/сх
     {
-        while               (flash.Busy);                                       // ждём готовность м/сх памяти
-        flash.Busy          = true;                                             // установка флага занятости м/сх памяти
-        uint64_t addr       = 0;                                                // подготовка буфера для формирования абсолютного адреса
-        Flash_Resume        ();                                                 // пробуждение микросхемы памяти
-        Flash_ChipSelect    (true);                                             // разрешение работы с м/сх памяти
-        Flash_WriteEnable   (true);                                             // разрешение записи в память
-    
-        if (flash.Id < 64)                                                      // при работе с AT45DBXX ->
+        FLASH_Xfer_t x      = Flash_ReadCmd (dev, devAddr);
+        x.Buf               = buf;                                              // только заголовок, Chip Select остаётся активным
+        x.Len               = 0;
+        x.Hold              = true;
+        ok                  = Flash_Xfer (dev, &x) && Flash_DmaPrepare (dev) &&
+                              Flash_HalOk (_FLASH_SPI_RX_DMA (dev->Bus, buf, len));
+        *dma                = ok;
+        if (!ok)
         {
-            addr            = area << flash.Shift;                              // вычисление абсолютного адреса страницы путём сдвига на заданное количество бит
-            Flash_Spi       (AT45_PGERASE);                                     // отправка команды:    0x81 - "стирание страницы"
-            Flash_Spi       ((uint8_t)(addr >> 16));                            // 1й операнд: отправка 3 фиктивных битов + PA[11:7]
-            Flash_Spi       ((uint8_t)(addr >>  8));                            // 2й операнд: отправка PA[6:0] + BA8
-            Flash_Spi       ((uint8_t)(addr      ));                            // 3й операнд: отправка BA[7:0]
+            dev->DmaWait    = false;
+            Flash_ChipSelect (dev, false);                                      // завершение работы с м/сх памяти
         }
-        else                                                                    // при работе с W25QXX ->
-        {
-            addr            = (area * flash.PgSize) << 4;                       // вычисление абсолютного адреса сектора (=адрес страницы * размер страницы * 16)
-            Flash_Spi       (W25_SE);                                           // отправка команды:    0x20 - "стирание сектора"
-            Flash_Spi       ((uint8_t)(addr >> 16));                            // 1й операнд: отправка A[23:16]
-            Flash_Spi       ((uint8_t)(addr >>  8));                            // 2й операнд: отправка A[15:8]
-            Flash_Spi       ((uint8_t)(addr      ));                            // 3й операнд: отправка A[7:0]
-        }
-    
-        Flash_ChipSelect    (false);                                            // завершение работы с м/сх памяти
-        while               (Flash_IsBusy ());                                  // ожидание готовности микросхемы flash-памяти
-        Flash_WriteEnable   (false);                                            // запрет записи в память
-        flash.Busy          = false;                                            // установка флага готовности м/сх памяти
+        return ok;
     }
+#endif
+    ok                      = Flash_ReadArray (dev, devAddr, buf, len);         // короткий массив или QUADSPI -> чтение с ожиданием
+    return ok;
 }
 
-void Flash_WritePage        (uint32_t page, uint32_t offset,                    // функция записи данных на микросхему Flash-памяти в указанную страницу с заданным смещением
-                                                    uint32_t size, uint8_t *buf)
+static bool Flash_ReadEnd   (FLASH_t *dev, uint32_t len, bool dma)              // функция завершения чтения, запущенного Flash_ReadBegin, и освобождения м/сх
 {
-    if (flash.Id)                                                               // когда м/сх памяти опознана ->
-    {
-        while               (flash.Busy);                                       // ждём готовность м/сх памяти
-        flash.Busy          = true;                                             // установка флага занятости м/сх памяти
-        uint64_t  addr      = 0;
-        if (size > flash.PgSize)                                                // проверка размера блока
-                size = flash.PgSize;
-        Flash_Resume        ();                                                 // пробуждение микросхемы памяти
-        Flash_ChipSelect    (true);                                             // разрешение работы с м/сх памяти
-        Flash_WriteEnable   (true);                                             // разрешение записи в память
-    
-        if (flash.Id < 64)                                                      // при работе с AT45DBXX ->
-        {
-            addr            = (page << flash.Shift) + offset;                   // вычисление абсолютного адреса для записи данных  путём сдвига на заданное количество бит с добавлением смещения
-            Flash_Spi       (AT45_MNTHRUBF1);                                   // отправка команды:    0x82 - "программирование основной страницы памяти через буфер 1 со встроенным стиранием"
-            Flash_Spi       ((uint8_t)(addr >> 16));                            // 1й операнд: отправка 3 фиктивных битов + PA[11:7]
-            Flash_Spi       ((uint8_t)(addr >>  8));                            // 2й операнд: отправка PA[6-0] + BA8
-            Flash_Spi       ((uint8_t)(addr      ));                            // 3й операнд: отправка BA[7-0]
-        }
-        else                                                                    // при работе с W25QXX ->
-        {
-            addr            = (page * flash.PgSize) + offset;                   // вычисление абсолютного адреса для записи данных
-            Flash_Spi       (W25_PP);                                           // отправка команды:    0x02 - "программирование страницы памяти"
-            Flash_Spi       ((uint8_t)(addr >> 16));                            // 1й операнд: отправка A[23:16]
-            Flash_Spi       ((uint8_t)(addr >>  8));                            // 2й операнд: отправка A[15:8]
-            Flash_Spi       ((uint8_t)(addr      ));                            // 3й операнд: отправка A[7:0]
-        }
-    
-        HAL_SPI_Transmit    (&_FLASH_SPI, buf, size, 100);                      // запись массива данных в м/сх
-    
-        Flash_ChipSelect    (false);                                            // завершение работы с м/сх памяти
-        Flash_WriteEnable   (false);                                            // запрет записи в память
-        flash.Busy          = false;                                            // установка флага готовности м/сх памяти
+    bool                    ok = true;
+#if (_FLASH_USE_DMA == 1 && _FLASH_USE_QSPI == 0)
+    if (dma)
+    {
+        ok                  = Flash_HalOk (Flash_DmaWait (dev, _FLASH_TIMEOUT (len)));
+        Flash_ChipSelect    (dev, false);                                       // завершение работы с м/сх памяти
     }
+#else
+    (void)len;
+    (void)dma;
+#endif
+    Flash_FinishRead        (dev);                                              // возобновление приостановленной операции
+    Flash_Unlock            (dev);                                              // освобождение м/сх памяти
+    return ok;
 }
-    
-void Flash_ReadPage         (uint32_t page, uint32_t offset,                    // функция чтения данных из микросхемы Flash-памяти с указанной страницы с заданным смещением
-                                                    uint32_t size, uint8_t *buf)
-{
-    if (flash.Id)                                                               // когда м/сх памяти опознана ->
-    {
-        while               (flash.Busy);                                       // ждём готовность м/сх памяти
-        flash.Busy          = true;                                             // установка флага занятости м/сх памяти
-        uint64_t addr       = 0;
-        if (size > flash.PgSize)                                                // проверка размера блока
-                size = flash.PgSize;
-        Flash_Resume        ();                                                 // пробуждение микросхемы памяти
-        Flash_ChipSelect    (true);                                             // разрешение работы с м/сх памяти
-    
-        if (flash.Id < 64)                                                      // при работе с AT45DBXX ->
-        {
-            addr            = (page << flash.Shift) + offset;                   // вычисление абсолютного адреса
-            Flash_Spi       (AT45_RDARRAYHF);                                   // отправка команды:    0x0B - "непрерывное чтение массива"
-            Flash_Spi       ((uint8_t)(addr >> 16));                            // 1й операнд: отправка 3 фиктивных битов + PA[11:7]
-            Flash_Spi       ((uint8_t)(addr >>  8));                            // 2й операнд: отправка PA[6-0] + BA8
-            Flash_Spi       ((uint8_t)(addr      ));                            // 3й операнд: отправка BA[7-0]
-            Flash_Spi       (DUMMY_BYTE);                                       // 4й операнд: отправка 8 фиктивных битов
-        }
-        else                                                                    // при работе с W25QXX ->
+
+static bool Flash_StripeInit (FLASH_t *dev)                                     // функция инициализации виртуального устройства по двум м/сх
+{                                                                               // м/сх инициализируются, если это не сделано раньше; страницы и стираемые блоки должны совпадать
+    FLASH_t  *a             = dev->Stripe[0];
+    FLASH_t  *b             = dev->Stripe[1];
+    dev->Id                 = 0;
+    if (b == NULL || a == b || a->Stripe[0] || b->Stripe[0] ||                  // вложенные виртуальные устройства не поддерживаются
+        !(a->Id || Flash_Init (a)) || !(b->Id || Flash_Init (b)) ||
+        a->PgSize != b->PgSize || a->ErasableSize != b->ErasableSize ||
+        !Flash_MutexInit (dev))                                                 // мьютекс виртуального устройства: две м/сх захватываются одной задачей
+        return false;
+    dev->PgSize             = a->PgSize;
+    dev->Pages              = 2 * (a->Pages < b->Pages ? a->Pages : b->Pages);  // объём - по меньшей м/сх
+    dev->ErasableSize       = 2 * a->ErasableSize;                              // стираемый блок - по блоку на каждой м/сх
+    dev->NumOfErasable      = a->NumOfErasable < b->NumOfErasable ? a->NumOfErasable : b->NumOfErasable;
+    dev->Shift              = a->Shift;
+    dev->Mnf                = a->Mnf;
+    dev->Family             = a->Family == b->Family ? a->Family : FLASH_FAMILY_NONE;
+    dev->Linear             = false;                                            // линейный адрес пересчитывается в страницу и м/сх
+    dev->Desc               = a->Desc;
+    dev->Id                 = a->Id;
+    return true;
+}
+
+static bool Flash_StripeRead (FLASH_t *dev, uint32_t addr, uint32_t len, uint8_t *buf)  // функция чтения массива виртуального устройства
+{                                                                               // две соседние страницы запускаются на обеих м/сх, затем ожидаются обе
+    bool                    ok = true;
+    bool      shared        = dev->Stripe[0]->Bus == dev->Stripe[1]->Bus ||     // м/сх на одной шине -> по очереди
+                              dev->Stripe[0]->BusOwner || dev->Stripe[1]->BusOwner;
+    if (!dev->Id || !len || addr >= dev->Pages * FLASH_PGSIZE (dev))            // устройство не инициализировано или адрес вне устройства
+        return false;
+    if (len > dev->Pages * FLASH_PGSIZE (dev) - addr)                           // ограничение чтения концом устройства
+        len                 = dev->Pages * FLASH_PGSIZE (dev) - addr;
+    FLASH_STAT_BEGIN        (t0);
+    Flash_Lock              (dev);                                              // захват виртуального устройства: две м/сх всегда захватываются одной задачей
+    for (uint32_t done = 0; done < len; )
+    {
+        FLASH_t  *m[2];
+        uint32_t  n[2];
+        bool      dma[2];
+        uint8_t   k         = 0;
+        for (; k < (shared ? 1 : 2) && done < len; k++)
         {
-            addr            = (page * flash.PgSize) + offset;                   // вычисление абсолютного адреса
-            Flash_Spi       (W25_FAST_READ);                                    // отправка команды:    0x0B - "быстрое чтение данных"
-            Flash_Spi       ((uint8_t)(addr >> 16));                            // 1й операнд: отправка A[23:16]
-            Flash_Spi       ((uint8_t)(addr >>  8));                            // 2й операнд: отправка A[15:8]
-            Flash_Spi       ((uint8_t)(addr      ));                            // 3й операнд: отправка A[7:0]
-            Flash_Spi       (DUMMY_BYTE);                                       // 4й операнд: отправка 8 фиктивных битов
+            uint32_t  page  = (addr + done) / FLASH_PGSIZE (dev);
+            uint32_t  off   = (addr + done) % FLASH_PGSIZE (dev);
+            m[k]            = dev->Stripe[page & 1];
+            n[k]            = FLASH_PGSIZE (dev) - off < len - done ? FLASH_PGSIZE (dev) - off : len - done;
+            ok              = Flash_ReadBegin (m[k], page >> 1, off, buf + done, n[k], &dma[k]) && ok;
+            done           += n[k];
         }
-        HAL_SPI_Receive     (&_FLASH_SPI, buf, size, 100);                      // чтение запрошенного массива данных из м/сх
-    
-        Flash_ChipSelect    (false);                                            // завершение работы с м/сх памяти
-        flash.Busy          = false;                                            // установка флага готовности м/сх памяти
+        for (uint8_t i = 0; i < k; i++)
+            ok              = Flash_ReadEnd (m[i], n[i], dma[i]) && ok;
     }
+    FLASH_STAT_END          (FLASH_STAT_READ, t0, len);
+    Flash_Unlock            (dev);                                              // освобождение виртуального устройства
+    return ok;
 }
 
-// ------------------------------- Функции-прокладки для связки LittleFS и SPI_Flash: -----------------------------------------------------
+static bool Flash_ProgPage (FLASH_t *dev, uint32_t page, uint32_t offset, uint32_t size, uint8_t *buf);
+static bool Flash_ProgPages (FLASH_t *dev, uint32_t page, uint32_t count, uint8_t *buf);
 
-int block_device_read       (const struct lfs_config *c, lfs_block_t block,     // функция-прокладка для чтения страницы с носителя.
-                                   lfs_off_t off, void *buffer, lfs_size_t size)
+static bool Flash_StripeWrite (FLASH_t *dev, uint32_t page, uint32_t count, uint8_t *buf)  // функция записи целых страниц виртуального устройства
+{                                                                               // страницы идут на м/сх поочерёдно: следующая принимается, пока предыдущая программируется
+    bool                    ok = dev->Id && count && page < dev->Pages && count <= dev->Pages - page;
+    Flash_Lock              (dev);                                              // захват виртуального устройства, затем м/сх - в том же порядке, что и при чтении
+    for (uint32_t i = 0; ok && i < count; i++, buf += FLASH_PGSIZE (dev))
+        ok                  = Flash_ProgPages (dev->Stripe[(page + i) & 1], (page + i) >> 1, 1, buf);
+    Flash_Unlock            (dev);                                              // освобождение виртуального устройства
+    return ok;
+}
+
+static bool Flash_StripeErase (FLASH_t *dev, uint32_t start, uint32_t len)      // функция стирания диапазона байтов виртуального устройства
+{                                                                               // на обеих м/сх стирается один и тот же диапазон, команды чередуются между м/сх
+    uint32_t  block         = dev->ErasableSize / 2;                            // стираемый блок одной м/сх
+    uint32_t  total         = dev->Pages * FLASH_PGSIZE (dev);
+    if (!dev->Id || !len || start >= total || len > total - start)              // устройство не инициализировано или диапазон вне устройства
+        return false;
+    uint32_t  addr          = start / dev->ErasableSize * block;                // диапазон на каждой м/сх, расширенный до границ стираемых блоков
+    uint32_t  end           = (start + len + dev->ErasableSize - 1) / dev->ErasableSize * block;
+    uint32_t  big           = dev->Desc.Erase[0].Pages * FLASH_PGSIZE (dev);    // порция - одна команда стирания: самая крупная, если помещается, иначе самая мелкая
+    bool                    ok = true;
+    Flash_Lock              (dev);                                              // захват виртуального устройства, затем м/сх - в том же порядке, что и при чтении
+    while (ok && addr < end)
+    {
+        uint32_t  next      = addr % big == 0 && end - addr >= big ? addr + big : addr + block;
+        ok                  = Flash_EraseRange (dev->Stripe[0], addr, next - addr) &
+                              Flash_EraseRange (dev->Stripe[1], addr, next - addr);  // вторая м/сх начинает стирать, не дожидаясь первой
+        addr                = next;
+    }
+    Flash_Unlock            (dev);                                              // освобождение виртуального устройства
+    return ok;
+}
+
+// ------------------------------- Упреждающее чтение последовательных обращений: -------------------------------------------------------
+// кольцо из двух половин по _FLASH_PREFETCH_PAGES / 2 страниц: когда чтения идут подряд, следующая половина принимается по DMA,
+// пока задача обрабатывает текущую. м/сх освобождается сразу после запуска приёма; Chip Select остаётся активным, и приём
+// завершает первый же захват шины (Flash_Lock). запись или стирание страниц кольца сбрасывает соответствующую половину.
+
+#if (FLASH_PREFETCH == 1)
+#define FLASH_PF_HALF           (_FLASH_PREFETCH_PAGES / 2)                     // страниц в половине кольца
+#define FLASH_PF_NONE           0xFFFFFFFF                                      // половина кольца пуста
+
+typedef struct FLASH_Prefetch_s
+{
+    FLASH_t    *Dev;                                                            // м/сх кольца (NULL - кольцо свободно)
+    uint32_t    Next;                                                           // страница, следующая за последней прочитанной
+    uint8_t     Run;                                                            // количество чтений подряд, продолжающих предыдущее
+    int8_t      Loading;                                                        // половина, приём в которую идёт по DMA (-1 - приёма нет)
+    uint32_t    Base[2];                                                        // первая страница половины (FLASH_PF_NONE - половина пуста)
+    uint8_t     Count[2];                                                       // принятые страницы половины
+    uint32_t    Used[2];                                                        // маска страниц половины, которые уже прочитаны
+    uint8_t     Data[2][FLASH_PF_HALF * _FLASH_CACHE_PGSIZE];                   // содержимое половин
+} FLASH_Prefetch_t;
+
+static FLASH_Prefetch_t     flashPrefetch[_FLASH_PREFETCH_DEVICES];             // кольца упреждающего чтения
+#endif
+FLASH_PrefetchStats_t       flashPrefetchStats;                                 // статистика упреждающего чтения
+
+#if (FLASH_PREFETCH == 1)
+static void Flash_PrefetchAttach (FLASH_t *dev)                                 // функция выдачи опознанной м/сх кольца упреждающего чтения (м/сх захвачена)
+{
+    FLASH_Prefetch_t *pf    = NULL;
+    _FLASH_IRQ_OFF          ();                                                 // м/сх на разных шинах инициализируются разными задачами
+    for (uint8_t i = 0; i < _FLASH_PREFETCH_DEVICES && pf == NULL; i++)
+        if (flashPrefetch[i].Dev == dev || flashPrefetch[i].Dev == NULL)
+            pf              = &flashPrefetch[i];
+    if (pf && FLASH_PGSIZE (dev) <= _FLASH_CACHE_PGSIZE)                        // страница должна помещаться в кольцо
+        pf->Dev             = dev;
+    else
+        pf                  = NULL;
+    _FLASH_IRQ_ON           ();
+    if (pf)
+    {
+        pf->Next            = FLASH_PF_NONE;
+        pf->Run             = 0;
+        pf->Loading         = -1;
+        pf->Base[0]         = FLASH_PF_NONE;
+        pf->Base[1]         = FLASH_PF_NONE;
+    }
+    dev->Prefetch           = pf;
+}
+
+static void Flash_PrefetchDrop (FLASH_Prefetch_t *pf, uint8_t half)             // функция освобождения половины кольца с учётом непрочитанных страниц
 {
-    Flash_ReadPage          ((uint32_t)block, (uint32_t)off,                    // чтение данных на указанной странице с заданным смещением и определенной длины
-                                              (uint32_t)size, (uint8_t*)buffer);
-	return 0;
+    if (pf->Base[half] == FLASH_PF_NONE)
+        return;
+    for (uint8_t i = 0; i < pf->Count[half]; i++)
+        if (!(pf->Used[half] & (1u << i)))
+            flashPrefetchStats.Wasted++;
+    pf->Base[half]          = FLASH_PF_NONE;
 }
 
-int block_device_prog       (const struct lfs_config *c, lfs_block_t block,     // функция-прокладка для записи страницы на носитель. страница должна быть заранее очищена.
-                             lfs_off_t off, const void *buffer, lfs_size_t size)
+static void Flash_PrefetchSettle (FLASH_t *own)                                 // функция завершения упреждающего чтения на шине (шина захвачена)
+{
+    FLASH_t  *dev           = own->Inflight;
+    if (dev == NULL)                                                            // приёма нет
+        return;
+    FLASH_Prefetch_t *pf    = dev->Prefetch;
+    own->Inflight           = NULL;
+    bool      ok            = Flash_HalOk (Flash_DmaWait (dev, _FLASH_TIMEOUT (FLASH_PF_HALF * FLASH_PGSIZE (dev))));
+    Flash_ChipSelect        (dev, false);                                       // завершение работы с м/сх памяти
+    Flash_FinishRead        (dev);
+    if (!ok)                                                                    // приём не удался -> половина пуста
+        pf->Base[pf->Loading] = FLASH_PF_NONE;
+    pf->Loading             = -1;
+}
+
+static bool Flash_PrefetchShared (FLASH_t *dev)                                 // функция проверки: шину м/сх делит устройство без общего с ней BusOwner
+{                                                                               // его обмен не ждёт Flash_PrefetchSettle и выбрал бы свою м/сх при активном Chip Select упреждающего чтения
+    FLASH_t  *own           = dev->BusOwner ? dev->BusOwner : dev;
+    for (uint8_t i = 0; i < _FLASH_DEVICES; i++)
+    {
+        FLASH_t  *d         = flashDevs[i];
+        if (d && d != dev && d->Bus == dev->Bus && (d->BusOwner ? d->BusOwner : d) != own)
+            return true;
+    }
+    return false;
+}
+#endif
+
+static bool Flash_PrefetchRead (FLASH_t *dev, uint32_t addr, uint32_t len, uint8_t *buf)  // функция чтения массива из кольца (м/сх захвачена; false - массива в кольце нет)
+{
+#if (FLASH_PREFETCH == 1)
+    FLASH_Prefetch_t *pf    = dev->Prefetch;
+    if (pf == NULL || !len)
+        return false;
+    for (uint32_t p = addr / FLASH_PGSIZE (dev); p <= (addr + len - 1) / FLASH_PGSIZE (dev); p++)  // все страницы массива должны быть приняты
+    {
+        uint8_t   h         = (p / FLASH_PF_HALF) & 1;
+        if (pf->Base[h] != p - p % FLASH_PF_HALF || pf->Loading == h || p - pf->Base[h] >= pf->Count[h])
+        {
+            flashPrefetchStats.Misses++;
+            return false;
+        }
+    }
+    while (len)
+    {
+        uint32_t  p         = addr / FLASH_PGSIZE (dev);
+        uint32_t  off       = addr % FLASH_PGSIZE (dev);
+        uint32_t  n         = FLASH_PGSIZE (dev) - off < len ? FLASH_PGSIZE (dev) - off : len;
+        uint8_t   h         = (p / FLASH_PF_HALF) & 1;
+        memcpy              (buf, &pf->Data[h][(p - pf->Base[h]) * FLASH_PGSIZE (dev) + off], n);
+        pf->Used[h]        |= 1u << (p - pf->Base[h]);
+        addr               += n;
+        buf                += n;
+        len                -= n;
+    }
+    flashPrefetchStats.Hits++;
+    return true;
+#else
+    (void)dev;
+    (void)addr;
+    (void)len;
+    (void)buf;
+    return false;
+#endif
+}
+
+static void Flash_PrefetchNext (FLASH_t *dev, uint32_t addr, uint32_t len)      // функция учёта прочитанного массива и запуска приёма следующей половины кольца (м/сх захвачена)
+{                                                                               // приём запускается, когда чтения идут подряд; длинные чтения и так идут одной командой
+#if (FLASH_PREFETCH == 1)
+    FLASH_Prefetch_t *pf    = dev->Prefetch;
+    if (pf == NULL || !len)
+        return;
+    uint32_t  first         = addr / FLASH_PGSIZE (dev);
+    uint32_t  last          = (addr + len - 1) / FLASH_PGSIZE (dev);
+    if (first == pf->Next || first + 1 == pf->Next)                             // продолжение предыдущего чтения (в том числе с его последней страницы)
+    {
+        if (pf->Run < 0xFF)
+            pf->Run++;
+    }
+    else
+        pf->Run             = 0;
+    pf->Next                = last + 1;
+    uint32_t  base          = (last / FLASH_PF_HALF + 1) * FLASH_PF_HALF;       // половина, следующая за текущей
+    uint8_t   h             = (last / FLASH_PF_HALF + 1) & 1;
+    if (pf->Run < _FLASH_PREFETCH_TRIGGER || len >= FLASH_PF_HALF * FLASH_PGSIZE (dev) ||
+        pf->Base[h] == base || base >= dev->Pages ||                            // половина уже принята или м/сх закончилась
+        dev->Pending != FLASH_OP_NONE ||                                        // идёт программирование/стирание: приостанавливать его ради упреждения не стоит
+        Flash_PrefetchShared (dev))                                             // шина общая без BusOwner: Chip Select нельзя оставлять активным
+        return;
+    Flash_PrefetchDrop      (pf, h);                                            // прочитанная половина освобождается под следующую
+    uint8_t   count         = dev->Pages - base < FLASH_PF_HALF ? dev->Pages - base : FLASH_PF_HALF;
+    FLASH_t  *own           = dev->BusOwner ? dev->BusOwner : dev;
+    Flash_PrepareRead       (dev, base, count);                                 // пробуждение м/сх
+    FLASH_Xfer_t x          = Flash_ReadCmd (dev, Flash_PageAddr (dev, base, 0));
+    x.Buf                   = pf->Data[h];                                      // только заголовок, Chip Select остаётся активным до Flash_PrefetchSettle
+    x.Len                   = 0;
+    x.Hold                  = true;
+    if (Flash_Xfer (dev, &x) && Flash_DmaPrepare (dev) &&
+        Flash_HalOk (_FLASH_SPI_RX_DMA (dev->Bus, pf->Data[h], count * FLASH_PGSIZE (dev))))
+    {
+        pf->Base[h]         = base;
+        pf->Count[h]        = count;
+        pf->Used[h]         = 0;
+        pf->Loading         = h;
+        own->Inflight       = dev;
+        flashPrefetchStats.Loads++;
+        return;
+    }
+    dev->DmaWait            = false;
+    Flash_ChipSelect        (dev, false);                                       // завершение работы с м/сх памяти
+    Flash_FinishRead        (dev);
+#else
+    (void)dev;
+    (void)addr;
+    (void)len;
+#endif
+}
+
+static void Flash_PrefetchInvalidate (FLASH_t *dev, uint32_t page, uint32_t pages)  // функция сброса половин кольца, пересекающихся со страницами [page, page + pages) (pages = 0 -> всех)
+{
+#if (FLASH_PREFETCH == 1)
+    FLASH_Prefetch_t *pf    = dev->Prefetch;
+    for (uint8_t h = 0; pf && h < 2; h++)
+        if (pf->Base[h] != FLASH_PF_NONE &&
+            (!pages || (page < pf->Base[h] + pf->Count[h] && pf->Base[h] < page + pages)))
+        {
+            Flash_PrefetchDrop (pf, h);
+            flashPrefetchStats.Invalidations++;
+        }
+#else
+    (void)dev;
+    (void)page;
+    (void)pages;
+#endif
+}
+
+bool Flash_Init             (FLASH_t *dev)                                      // функция инициализации микросхемы flash-памяти (или виртуального устройства из двух м/сх)
+{
+    if (dev->Stripe[0])
+        return Flash_StripeInit (dev);
+    if (!Flash_MutexInit (dev->BusOwner ? dev->BusOwner : dev))                 // мьютексы создаются здесь, до захватов задачами: ленивое создание в Flash_Lock гонялось бы
+    {
+        dev->Id             = 0;
+        return false;
+    }
+    if (!Flash_Register (dev))                                                  // м/сх доступна обработчику DMA (до первого обмена) и таймеру простоя
+    {
+        dev->Id             = 0;                                                // больше _FLASH_DEVICES м/сх: без записи в списке DMA по шине м/сх не завершится
+        return false;
+    }
+    Flash_Lock              (dev);                                              // захват м/сх памяти
+    dev->Id                 = 0;                                                // подготовка переменной для номера-идентификатора м/сх памяти. 0 -> м/сх не опознана, 1-255 -> м/сх идентифицирована
+    dev->Family             = FLASH_FAMILY_NONE;
+    dev->Pending            = FLASH_OP_NONE;                                    // внутренних операций м/сх не запущено
+    dev->Lines              = 1;                                                // до настройки м/сх чтение - по одной линии
+    dev->AddrLen            = 3;                                                // до опознания м/сх - 3-байтный адрес
+    dev->BusyPolls          = 0;                                                // сброс статистики ожидания готовности м/сх
+    dev->BusySleep          = 0;
+    dev->SkippedWrites      = 0;                                                // сброс статистики исключённых записей
+    dev->SkippedErases      = 0;
+    dev->PendingTimeouts    = 0;
+    dev->Suspends           = 0;
+    dev->Suspended          = false;
+    dev->Asleep             = false;                                            // после аппаратного сброса м/сх не спит
+#if (_FLASH_USE_STATS == 1)
+    _FLASH_CYCLES_INIT      ();                                                 // запуск счётчика тактов для измерения задержек
+#endif
+    uint8_t  jedec[5]       = {0};                                              // ответ на команду чтения идентификатора
+    Flash_Reset             (dev);                                              // аппаратный сброс м/сх памяти
+    Flash_ChipSelect        (dev, false);                                       // подготовка после включения
+    while (_FLASH_TICK () < 20)                                                 // обеспечение принудительной задержки перед инициализацией м/сх
+        _FLASH_DELAY        (DELAY/10);
+    Flash_Command           (dev, FLASH_RESUME);                                // м/сх могла остаться усыплённой до перезапуска контроллера
+    _FLASH_DELAY_US         (AT45_TRDPD_US);                                    // наибольшее tRES1 из поддерживаемых м/сх
+    FLASH_Xfer_t x          = { .Cmd = FLASH_GET_JEDEC_ID,                      // команда: 0x9F - "считывание идентификатора производителя и устройства"
+                                .Dir = FLASH_DIR_RX, .Buf = jedec, .Len = sizeof (jedec) };
+    Flash_Xfer              (dev, &x);
+    uint8_t  mnfId          = jedec[0];                                         // Manufacturer ID
+    dev->Mnf                = mnfId;
+    uint32_t Id             = ((uint32_t)jedec[1] << 24) |                      // Device ID Byte 1
+                              ((uint32_t)jedec[2] << 16) |                      // Device ID Byte 2
+                              ((uint32_t)jedec[3] <<  8) |                      // Extended Device Information String Length
+                               (uint32_t)jedec[4];                              // Extended Device Information Byte 1
+
+    uint8_t  mnf            = mnfId == MX25_MACRONIX ? W25_WINBOND : mnfId;     // MX25LXXXX совпадают с W25QXXX по командам и коду объёма
+    const FLASH_Desc_t *d   = Flash_FindPart (mnf, Id);                         // поиск м/сх в таблице известных м/сх
+    if (d && d->Family == FLASH_FAMILY_AT45)                                    // AT45DBXXX: геометрия по фактическому размеру страницы
+        d                   = Flash_At45PageMode (dev, d, Id);
+    if (d)
+        dev->Desc           = *d;
+    else if (_FLASH_FAMILY == FLASH_FAMILY_AT45 || !Flash_Sfdp (dev, &dev->Desc))  // м/сх нет в таблице и она не описывает себя через SFDP -> продолжение работы с м/сх памяти не имеет смысла
+    {                                                                           // (сборка только для AT45DBXXX: SFDP не разбирается)
+        Flash_Unlock        (dev);                                              // освобождение м/сх памяти (Id = 0 -> все операции пропускаются)
+        return false;                                                           // возврат неудачной инициализации м/сх
+    }
+    if ((_FLASH_FAMILY && dev->Desc.Family != _FLASH_FAMILY) ||                 // драйвер собран под другое семейство или другой размер страницы
+        (_FLASH_PG_SHIFT && dev->Desc.PgSize != 1u << _FLASH_PG_SHIFT))
+    {
+        Flash_Unlock        (dev);                                              // освобождение м/сх памяти
+        return false;
+    }
+    dev->PgSize             = dev->Desc.PgSize;                                 // размер одной страницы памяти в байтах
+    dev->Pages              = dev->Desc.Pages;                                  // общее количество страниц памяти на м/сх
+    dev->Shift              = dev->Desc.Shift;                                  // число битов смещения внутри страницы в адресе команды
+    dev->AddrLen            = dev->Desc.AddrLen;                                // количество байтов адреса в командах массива
+    dev->Family             = dev->Desc.Family;                                 // семейство м/сх
+    dev->Linear             = dev->PgSize == 1u << dev->Shift;                  // страница 2^n байт -> адрес команды = линейный адрес
+    dev->ErasableSize       = dev->Desc.Erase[2].Pages * dev->PgSize;           // минимальный размер стираемого блока (только для LittleFS)
+    dev->NumOfErasable      = dev->Pages / dev->Desc.Erase[2].Pages;            // общее количество стираемых блоков   (только для LittleFS)
+    dev->Id                 = dev->Desc.Id;                                     // уникальный номер-идентификатор м/сх (для внутренних нужд)
+#if (_FLASH_USE_FREERTOS == 1 && _FLASH_IDLE_MS > 0)
+    if (flashIdleTimer == NULL)                                                 // периодическая проверка простоя: на горячем пути - только отметка времени
+    {
+        flashIdleTimer      = xTimerCreate ("flashIdle", pdMS_TO_TICKS (_FLASH_IDLE_MS), pdTRUE, NULL, Flash_IdleTimer);
+        if (flashIdleTimer != NULL)
+            xTimerStart     (flashIdleTimer, 0);
+    }
+#endif
+#if (_FLASH_USE_QSPI == 1)
+    if (FLASH_IS_NOR (dev) &&
+        (_FLASH_QSPI_LINES == 2 ||                                              // Dual Output не требует бита QE
+         (_FLASH_QSPI_LINES == 4 && Flash_SetQuadEnable (dev))))                // Quad I/O: установка бита QE; не удалось -> остаёмся на одной линии
+        dev->Lines          = _FLASH_QSPI_LINES;
+#endif
+#if (FLASH_PREFETCH == 1)
+    Flash_PrefetchAttach    (dev);                                              // кольцо упреждающего чтения, пока они не закончились
+#endif
+    Flash_Unlock            (dev);                                              // освобождение м/сх памяти
+    return true;                                                                // возврат успешной инициализации м/сх
+}
+
+static uint8_t Flash_ReadStatus (FLASH_t *dev)                                  // функция чтения (первого) байта регистра состояния м/сх
+{
+    uint8_t                 status[2] = {0};                                    // подготовка буфера для чтения регистра статуса м/сх памяти
+    FLASH_Xfer_t x          = { .Dir = FLASH_DIR_RX, .Buf = status };
+    if (FLASH_IS_AT45 (dev))                                                    // при работе с AT45DBXXX ->
+    {
+        x.Cmd               = AT45_RDSR;                                        // команда:    0xD7 - "считывание регистра состояния"
+        x.Len               = 2;                                                // 2 байта регистра состояния
+    }
+    else                                                                        // при работе с W25QXX ->
+    {
+        x.Cmd               = W25_RDSR1;                                        // команда:    0x05 - "считывание регистра состояния 1"
+        x.Len               = 1;                                                // регистр состояния 1
+    }
+    Flash_Xfer              (dev, &x);                                          // команда и ответ - одной посылкой
+    return status[0];
+}
+
+bool Flash_IsBusy           (FLASH_t *dev)                                      // функция ожидания готовности микросхемы Flash-памяти.
+{                                                                               // необходимость функции продиктована продолжительным процессом записи. для определения его окончания нужна эта функция.
+    uint8_t                 status = Flash_ReadStatus (dev);
+    FLASH_STAT_INC          (BusyPolls);
+    if (FLASH_IS_AT45 (dev))
+        return (status & AT45_SR_RDY) == 0;                                     // AT45DBXXX: бит RDY сброшен -> м/сх памяти занята
+    return (status & W25_SR1S0) != 0;                                           // W25QXX:    бит BUSY установлен -> м/сх памяти занята
+}
+
+static bool Flash_ReadCompare (FLASH_t *dev, uint32_t devAddr, const uint8_t *ref, uint32_t len)  // функция сравнения содержимого м/сх с массивом (ref = NULL -> проверка на стёртость 0xFF)
+{                                                                               // массив читается одной командой небольшими порциями, при первом отличии чтение прерывается
+    uint8_t   tmp[64];                                                          // порция прочитанных данных
+    FLASH_Xfer_t x          = Flash_ReadCmd (dev, devAddr);
+#if (_FLASH_USE_QSPI == 0)
+    x.Buf                   = tmp;
+    x.Hold                  = true;
+    if (!Flash_Xfer (dev, &x))                                                  // заголовок команды, Chip Select остаётся активным
+        return false;
+#endif
+    bool      same          = true;
+    while (same && len)
+    {
+        uint32_t  n         = len < sizeof (tmp) ? len : sizeof (tmp);
+#if (_FLASH_USE_QSPI == 1)
+        x.Buf               = tmp;                                              // QUADSPI: каждая порция - отдельная команда чтения
+        x.Len               = n;
+        same                = Flash_Xfer (dev, &x);
+        x.Addr             += n;
+#else
+        same                = Flash_HalOk (_FLASH_SPI_RX (dev->Bus, tmp, n, _FLASH_TIMEOUT (n)));  // приём без DMA: запуск DMA на каждую короткую порцию дороже самой порции
+#endif
+        for (uint32_t i = 0; same && i < n; i++)
+            same            = tmp[i] == (ref ? ref[i] : 0xFF);
+        if (ref)
+            ref            += n;
+        len                -= n;
+    }
+#if (_FLASH_USE_QSPI == 0)
+    Flash_ChipSelect        (dev, false);                                       // завершение работы с м/сх памяти
+#endif
+    return same;
+}
+
+static void Flash_SetPending(FLASH_t *dev, uint8_t op, uint32_t page,           // функция регистрации запущенной внутренней операции м/сх (программирование/стирание)
+                                           uint32_t pages, uint32_t ms, uint32_t maxMs)
+{                                                                               // page, pages - занятые страницы (pages = 0 -> не приостанавливается), ms - типовое время, maxMs - максимальное
+    uint32_t  now           = _FLASH_TICK ();
+    dev->Pending            = op;                                               // тип операции
+    dev->PendingPage        = page;
+    dev->PendingPages       = pages;
+    dev->PendingUntil       = now + ms + 1;                                     // ожидаемый момент завершения (+1 тик на неполный текущий тик)
+    dev->PendingDeadline    = now + (maxMs > ms ? maxMs : ms) + 1;              // после этого момента м/сх считается зависшей
+    dev->PendingSuspends    = 0;
+    Flash_PrefetchInvalidate (dev, page, pages);                                // принятые заранее копии этих страниц устарели
+}
+
+static void Flash_WaitPending (FLASH_t *dev)                                    // функция ожидания завершения внутренней операции м/сх, если она запущена
+{
+    if (dev->Pending == FLASH_OP_NONE)                                          // м/сх ничем не занята -> ждать нечего
+        return;
+    FLASH_STAT_BEGIN        (t0);
+    int32_t left            = (int32_t)(dev->PendingUntil - _FLASH_TICK ());    // остаток ожидаемого времени операции
+    if (left > 0)
+    {
+        _FLASH_DELAY        (left);                                             // сон на всё ожидаемое время вместо непрерывного опроса
+        dev->BusySleep     += left;                                             // время, отданное другим задачам
+    }
+    uint32_t  step          = 0;                                                // интервал между опросами регистра состояния (мс)
+    if (dev->Pending == FLASH_OP_ERASE ||                                       // стирание области затянулось -> опрос каждую миллисекунду
+        (dev->Pending == FLASH_OP_PROGRAM && dev->Desc.TppMaxMs > 1))           // программирование может длиться миллисекунды (AT45DBXXX: до 35 мс) -> тоже
+        step                = 1;
+    else if (dev->Pending == FLASH_OP_CHIPERASE)                                // стирание чипа (десятки секунд) -> опрос каждые _FLASH_CE_POLL_MS
+        step                = _FLASH_CE_POLL_MS;
+    while (Flash_IsBusy (dev))                                                  // программирование страницы NOR короче миллисекунды -> опрос без сна
+    {
+        dev->BusyPolls++;
+        if ((int32_t)(_FLASH_TICK () - dev->PendingDeadline) > 0)               // максимальное время операции истекло -> ожидание прекращается
+        {
+            dev->PendingTimeouts++;
+            break;
+        }
+        if (step)
+        {
+            _FLASH_DELAY    (step);
+            dev->BusySleep  += step;
+        }
+    }
+    dev->BusyPolls++;                                                           // последний, успешный опрос
+    dev->Pending            = FLASH_OP_NONE;                                    // м/сх свободна
+    FLASH_STAT_END          (FLASH_STAT_WAIT, t0, 0);
+}
+
+static void Flash_PrepareRead (FLASH_t *dev, uint32_t page, uint32_t pages)     // функция подготовки м/сх к чтению страниц [page, page + pages) (м/сх захвачена)
+{                                                                               // идёт программирование/стирание других страниц -> оно приостанавливается на время чтения,
+    bool      apart         = page + pages <= dev->PendingPage ||               // иначе - ожидание его завершения и пробуждение м/сх
+                              page >= dev->PendingPage + dev->PendingPages;
+    if (dev->Desc.SuspendCmd && dev->Pending != FLASH_OP_NONE && dev->PendingPages && apart &&
+        dev->PendingSuspends < _FLASH_SUSPEND_MAX &&                            // бюджет приостановок: поток чтений не откладывает операцию бесконечно
+        (int32_t)(dev->PendingUntil - _FLASH_TICK ()) > 0)                      // операция ещё идёт: после ожидаемого срока дешевле дождаться её
+    {
+        FLASH_STAT_BEGIN    (t0);
+        Flash_Command       (dev, dev->Desc.SuspendCmd);                        // 0x75 / 0xB0 - "приостановка программирования/стирания"
+        _FLASH_DELAY_US     (dev->Desc.TsusUs);                                 // до истечения tSUS м/сх остаётся занятой
+        bool      busy      = Flash_IsBusy (dev);                               // м/сх свободна: операция приостановлена или успела завершиться
+        for (uint8_t i = 0; busy && i < _FLASH_SUSPEND_POLLS; i++)              // опрос - не дольше нескольких tSUS, а не до срока операции
+        {
+            _FLASH_DELAY_US (dev->Desc.TsusUs);
+            dev->BusyPolls++;
+            busy            = Flash_IsBusy (dev);
+        }
+        dev->PendingSuspends++;
+        FLASH_STAT_END      (FLASH_STAT_SUSPEND, t0, 0);
+        if (!busy)
+        {
+            dev->Suspended  = true;                                             // возобновление обязательно: команда возобновления завершённой операцией игнорируется
+            dev->SuspendedAt = _FLASH_TICK ();
+            dev->Suspends++;
+            return;
+        }
+        Flash_Command       (dev, dev->Desc.ResumeCmd);                         // м/сх не приостановилась -> команда отменяется, операция дожидается завершения
+        dev->PendingSuspends = _FLASH_SUSPEND_MAX;                              // следующие чтения этой операции её не приостанавливают
+    }
+    Flash_Resume            (dev);                                              // ожидание завершения операции и пробуждение м/сх
+}
+
+static void Flash_FinishRead (FLASH_t *dev)                                     // функция возобновления операции, приостановленной Flash_PrepareRead
+{
+    if (dev->Suspended)
+    {
+        uint32_t  paused    = _FLASH_TICK () - dev->SuspendedAt;
+        Flash_Command       (dev, dev->Desc.ResumeCmd);                         // 0x7A / 0xD0 - "возобновление программирования/стирания"
+        dev->PendingUntil  += paused;                                           // операция стояла -> её сроки сдвигаются
+        dev->PendingDeadline += paused;
+        dev->Suspended      = false;
+        _FLASH_DELAY_US     (dev->Desc.TsusUs);                                 // до следующей приостановки операция должна продвинуться
+    }
+}
+
+bool Flash_IsIdle           (FLASH_t *dev)                                      // функция проверки завершения последней операции программирования/стирания без ожидания
+{
+    bool                    idle = true;
+    if (dev->Stripe[0])                                                         // виртуальное устройство: свободно, когда свободны обе м/сх
+        return Flash_IsIdle (dev->Stripe[0]) & Flash_IsIdle (dev->Stripe[1]);
+    if (dev->Pending != FLASH_OP_NONE)                                          // операция запущена ->
+    {
+        if ((int32_t)(dev->PendingUntil - _FLASH_TICK ()) > 0)                  // ожидаемое время не истекло -> шину не трогаем
+            return false;
+        Flash_Lock          (dev);                                              // захват м/сх памяти
+        idle                = dev->Pending == FLASH_OP_NONE || !Flash_IsBusy (dev);
+        if (idle)
+            dev->Pending    = FLASH_OP_NONE;                                    // операция завершена
+        Flash_Unlock        (dev);                                              // освобождение м/сх памяти
+    }
+    return idle;
+}
+
+void Flash_WaitIdle         (FLASH_t *dev)                                      // функция ожидания завершения последней операции программирования/стирания
+{
+    if (dev->Stripe[0])                                                         // виртуальное устройство: м/сх программируют/стирают одновременно -> ждём обе
+    {
+        Flash_WaitIdle      (dev->Stripe[0]);
+        Flash_WaitIdle      (dev->Stripe[1]);
+        return;
+    }
+    Flash_Lock              (dev);                                              // захват м/сх памяти
+    Flash_WaitPending       (dev);                                              // сон на ожидаемое время операции с последующим опросом
+    Flash_Unlock            (dev);                                              // освобождение м/сх памяти
+}
+
+void Flash_Resume           (FLASH_t *dev)                                      // функция пробуждения м/сх Flash-памяти после сна
+{                                                                               // м/сх не спит -> только ожидание запущенной операции, без обмена по шине
+    if (dev->Stripe[0])                                                         // виртуальное устройство -> пробуждение обеих м/сх
+    {
+        Flash_Resume        (dev->Stripe[0]);
+        Flash_Resume        (dev->Stripe[1]);
+    }
+    else if (dev->Id)                                                           // когда м/сх памяти опознана ->
+    {
+        Flash_WaitPending   (dev);                                              // запущенная ранее операция должна завершиться: м/сх занята и не принимает команды
+        if (dev->Asleep)                                                        // м/сх действительно спит ->
+        {
+            FLASH_STAT_BEGIN (t0);
+            Flash_Command   (dev, FLASH_RESUME);                                // отправка команды:    0xAB - "возобновление работы после сна"
+            FLASH_STAT_INC  (Wakeups);
+            _FLASH_DELAY_US (FLASH_IS_AT45 (dev) ? AT45_TRDPD_US : W25_TRES1_US);  // до истечения tRES1 м/сх команды не принимает
+            dev->Asleep     = false;
+            FLASH_STAT_END  (FLASH_STAT_RESUME, t0, 0);
+        }
+    }
+}
+
+static void Flash_Sleep     (FLASH_t *dev)                                      // функция усыпления м/сх (м/сх захвачена вызывающей функцией)
+{
+    if (dev->Id && !dev->Asleep)                                                // когда м/сх памяти опознана и ещё не спит
+    {
+        Flash_WaitPending   (dev);                                              // занятая м/сх игнорирует команду усыпления
+        Flash_Command       (dev, FLASH_PWRDOWN);                               // отправка команды:    0xB9 - "усыпление микросхемы Flash-памяти"
+        dev->Asleep         = true;
+    }
+}
+
+void Flash_PowerDown        (FLASH_t *dev)                                      // функция усыпления м/сх Flash-памяти
+{
+    if (dev->Stripe[0])                                                         // виртуальное устройство -> усыпление обеих м/сх
+    {
+        Flash_PowerDown     (dev->Stripe[0]);
+        Flash_PowerDown     (dev->Stripe[1]);
+        return;
+    }
+    Flash_Lock              (dev);                                              // захват м/сх памяти
+    Flash_Sleep             (dev);
+    Flash_Unlock            (dev);                                              // освобождение м/сх памяти
+}
+
+void Flash_IdleTask         (FLASH_t *dev)                                      // функция усыпления м/сх после простоя _FLASH_IDLE_MS (FreeRTOS - из таймера, без ОС - из главного цикла)
+{
+#if (_FLASH_IDLE_MS > 0)
+    if (dev->Stripe[0])                                                         // виртуальное устройство -> каждая м/сх засыпает по своему простою
+    {
+        Flash_IdleTask      (dev->Stripe[0]);
+        Flash_IdleTask      (dev->Stripe[1]);
+        return;
+    }
+    if (!dev->Id || dev->Asleep || dev->Busy ||                                 // м/сх уже спит или занята задачей -> следующая проверка
+        _FLASH_TICK () - dev->LastAccess < _FLASH_IDLE_MS)                      // простой ещё не истёк
+        return;
+#if (_FLASH_USE_FREERTOS == 1)
+    FLASH_t  *own           = dev->BusOwner ? dev->BusOwner : dev;
+    if (own->Mutex == NULL || xSemaphoreTake ((SemaphoreHandle_t)own->Mutex, 0) != pdTRUE)  // задача таймеров не ждёт мьютекс: м/сх занята -> она не простаивает
+        return;
+#if (FLASH_PREFETCH == 1)
+    Flash_PrefetchSettle    (own);
+#endif
+    dev->Busy               = true;
+#else
+    Flash_Lock              (dev);
+#endif
+    bool      idle          = dev->Pending == FLASH_OP_NONE;                    // программирование/стирание не идёт
+    if (!idle && (int32_t)(dev->PendingUntil - _FLASH_TICK ()) <= 0)            // операция должна была завершиться -> одно чтение состояния без ожидания:
+    {                                                                           // задача таймеров не блокируется, занятая м/сх усыпляется при следующей проверке
+        dev->BusyPolls++;
+        idle                = !Flash_IsBusy (dev);
+        if (idle)
+            dev->Pending    = FLASH_OP_NONE;                                    // м/сх свободна: Flash_Sleep не ждёт
+    }
+    if (idle)
+        Flash_Sleep         (dev);
+    Flash_Unlock            (dev);                                              // освобождение м/сх памяти
+#else
+    (void)dev;
+#endif
+}
+
+#if (_FLASH_USE_FREERTOS == 1 && _FLASH_IDLE_MS > 0)
+static void Flash_IdleTimer (TimerHandle_t timer)                               // функция-обработчик таймера проверки простоя всех инициализированных м/сх
+{
+    (void)timer;
+    for (uint8_t i = 0; i < _FLASH_DEVICES; i++)
+        if (flashDevs[i])
+            Flash_IdleTask  (flashDevs[i]);
+}
+#endif
+
+void Flash_EraseChip        (FLASH_t *dev)                                      // функция стирания данных из м/сх Flash-памяти
 {
-    Flash_WritePage         ((uint32_t)block, (uint32_t)off,                    // запись данных на указанную страницу с заданным смещением и определенной длины 
-                                              (uint32_t)size, (uint8_t*)buffer);
-	return 0;
+    Flash_CacheInvalidate   (dev, 0, dev->Pages);                               // кэшированные страницы м/сх устаревают
+    if (dev->Stripe[0])                                                         // виртуальное устройство: обе м/сх стираются одновременно
+    {
+        Flash_EraseChip     (dev->Stripe[0]);
+        Flash_EraseChip     (dev->Stripe[1]);
+    }
+    else if (dev->Id)                                                           // когда м/сх памяти опознана ->
+    {
+        FLASH_STAT_BEGIN    (t0);
+        Flash_Lock          (dev);                                              // захват м/сх памяти
+        Flash_Resume        (dev);                                              // пробуждение микросхемы памяти
+        Flash_WriteEnable   (dev, true);                                        // разрешение записи в память
+        uint8_t  seq[3]     = { AT45_CHIPERASE2, AT45_CHIPERASE3, AT45_CHIPERASE4 };  // AT45DBXX: байты 2-4 команды стирания чипа
+        FLASH_Xfer_t x      = { .Cmd = FLASH_CHIP_ERASE };                      // команда:    0xC7 - "стирание чипа"
+        if (FLASH_IS_AT45 (dev))                                                // особенности очистки чипа при работе с AT45DBXX ->
+        {
+            x.Dir           = FLASH_DIR_TX;                                     // 0x94, 0x80, 0x9A - продолжение команды
+            x.Buf           = seq;
+            x.Len           = sizeof (seq);
+        }
+        Flash_WriteLatch    (dev);                                              // W25QXX: 0x06 - "разрешение записи"
+        Flash_Xfer          (dev, &x);
+        Flash_SetPending    (dev, FLASH_OP_CHIPERASE, 0, 0, dev->Desc.TceMs, dev->Desc.TceMaxMs);  // завершения не ждём: его дождётся следующая операция
+        Flash_WriteEnable   (dev, false);                                       // запрет записи в память
+        FLASH_STAT_END      (FLASH_STAT_CHIPERASE, t0, dev->Pages * FLASH_PGSIZE (dev));
+        Flash_Unlock        (dev);                                              // освобождение м/сх памяти
+    }
+}
+
+bool Flash_EraseRange       (FLASH_t *dev, uint32_t start, uint32_t len)        // функция стирания диапазона байтов наименьшим числом самых крупных команд стирания
+{                                                                               // диапазон расширяется до границ минимальной стираемой области
+    const FLASH_Erase_t *ops = dev->Desc.Erase;                                 // команды стирания м/сх из её описания, от крупной к мелкой
+    uint32_t  total         = dev->Pages * FLASH_PGSIZE (dev);
+    if (!dev->Id || !len || start >= total || len > total - start)              // м/сх не опознана или диапазон вне м/сх (start + len не вычисляется: переполнение)
+        return false;
+    uint32_t  unit          = dev->ErasableSize / FLASH_PGSIZE (dev);           // страниц в минимальной стираемой области
+    Flash_CacheInvalidate   (dev, start / dev->ErasableSize * unit,             // страницы кэша в расширенном диапазоне устаревают
+                             ((start % dev->ErasableSize + len - 1) / dev->ErasableSize + 1) * unit);
+    if (dev->Stripe[0])
+        return Flash_StripeErase (dev, start, len);
+    uint32_t  page          = start / FLASH_PGSIZE (dev);                       // первая страница диапазона
+    uint32_t  end           = (start + len + FLASH_PGSIZE (dev) - 1) / FLASH_PGSIZE (dev);  // страница, следующая за последней
+    page                   -= page % ops[2].Pages;                              // расширение до границ минимальной стираемой области
+    end                    += (ops[2].Pages - end % ops[2].Pages) % ops[2].Pages;
+    bool                    ok = true;
+    FLASH_STAT_BEGIN        (t0);
+    while (ok && page < end)
+    {
+        const FLASH_Erase_t *op = &ops[2];
+        for (uint8_t i = 0; i < 2; i++)                                         // выбор самой крупной команды, которая выровнена, помещается в остаток диапазона
+            if (ops[i].Pages && page % ops[i].Pages == 0 && end - page >= ops[i].Pages &&  // и стирает быстрее, чем команды следующего размера
+                ops[i].Ms < ops[i].Pages / ops[i + 1].Pages * ops[i + 1].Ms &&
+                !(FLASH_IS_AT45 (dev) && i == 0 && page == 0))                  // сектор 0 у AT45DBXXX разделён на 0a/0b -> стирается блоками
+            {
+                op          = &ops[i];
+                break;
+            }
+        FLASH_Xfer_t x      = { .Cmd = op->Cmd, .AddrLen = dev->AddrLen, .Addr = Flash_PageAddr (dev, page, 0) };
+        Flash_Lock          (dev);                                              // захват м/сх памяти на одну команду: между командами м/сх доступна другим задачам
+        Flash_Resume        (dev);                                              // пробуждение м/сх и ожидание завершения предыдущего стирания
+        if (dev->WriteAvoid && Flash_ReadCompare (dev, x.Addr, NULL, op->Pages * FLASH_PGSIZE (dev)))  // область уже стёрта -> чтение много быстрее стирания
+            dev->SkippedErases++;
+        else
+        {
+            Flash_WriteEnable (dev, true);                                      // разрешение записи в память
+            ok              = Flash_WriteLatch (dev) && Flash_Xfer (dev, &x);   // W25QXX: 0x06 - "разрешение записи", затем команда стирания
+            if (ok)                                                             // команда не ушла -> стирание не началось, ждать нечего
+                Flash_SetPending (dev, FLASH_OP_ERASE, page, op->Pages, op->Ms, op->MaxMs);  // завершения не ждём: его дождётся следующая операция
+            Flash_WriteEnable (dev, false);                                     // запрет записи в память
+        }
+        Flash_Unlock        (dev);                                              // освобождение м/сх памяти
+        page               += op->Pages;
+    }
+    FLASH_STAT_END          (FLASH_STAT_ERASE, t0, len);                        // учитывается запрошенный объём
+    return ok;
+}
+
+void Flash_EraseArea        (FLASH_t *dev, uint32_t area)                       // функция очистки указанной области на микросхеме Flash-памяти
+{                                                                               // AT45DBXXX: область = страница, W25QXX: область = сектор 4 Кб
+    Flash_EraseRange        (dev, area * dev->ErasableSize, dev->ErasableSize);
+}
+
+static bool Flash_At45Ready (FLASH_t *dev, uint8_t *status)                     // функция ожидания конца передачи страницы в буфер или сравнения (сотни микросекунд -> опрос без сна)
+{                                                                               // результат: false - м/сх не освободилась за AT45_TXFR_MAX_MS
+    uint32_t  deadline      = _FLASH_TICK () + AT45_TXFR_MAX_MS + 1;            // +1 тик на неполный текущий тик
+    while (((*status = Flash_ReadStatus (dev)) & AT45_SR_RDY) == 0)
+    {
+        dev->BusyPolls++;
+        if ((int32_t)(_FLASH_TICK () - deadline) > 0)                           // м/сх зависла -> ожидание прекращается, страница не обновляется
+        {
+            dev->PendingTimeouts++;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool Flash_At45Update (FLASH_t *dev, uint32_t page, uint32_t offset,     // функция частичного обновления страницы AT45DBXXX средствами м/сх ("чтение-модификация-запись" в SRAM-буфере)
+                                                    const FLASH_Seg_t *seg, uint8_t count)
+{                                                                               // по SPI передаются только изменяемые байты (сегменты подряд с offset), буфер размером со страницу в ОЗУ не нужен
+    FLASH_Xfer_t x          = { .Cmd = AT45_MNTOBF1XFR, .AddrLen = 3,           // 0x53 - "передача страницы основной памяти в буфер 1"
+                                .Addr = Flash_PageAddr (dev, page, 0) };
+    bool      ok            = true;
+    if (Flash_SegLen (seg, count) < FLASH_PGSIZE (dev))                         // страница перезаписывается не целиком -> сохраняемые байты берутся из основной памяти
+    {
+        uint8_t   status;
+        ok                  = Flash_Xfer (dev, &x) && Flash_At45Ready (dev, &status);
+    }
+    x                       = (FLASH_Xfer_t){ .Cmd = AT45_WRBF1, .AddrLen = 3,  // 0x84 - "запись буфера 1": только изменяемые байты
+                                              .Addr = offset, .Dir = FLASH_DIR_TX };
+    ok                      = ok && Flash_XferV (dev, &x, seg, count);
+    if (ok && dev->WriteAvoid)                                                  // режим исключения лишних записей -> сравнение буфера со страницей силами м/сх
+    {
+        x                   = (FLASH_Xfer_t){ .Cmd = AT45_MNBF1CMP, .AddrLen = 3,  // 0x60 - "сравнение страницы основной памяти с буфером 1"
+                                              .Addr = Flash_PageAddr (dev, page, 0) };
+        uint8_t   status;
+        ok                  = Flash_Xfer (dev, &x) && Flash_At45Ready (dev, &status);  // команда не передана -> ждать нечего
+        if (ok && (status & AT45_SR_COMP) == 0)                                 // COMP = 0 -> данные на м/сх совпадают, стирание и программирование не нужны
+        {
+            dev->SkippedWrites++;
+            dev->SkippedErases++;
+            return true;
+        }
+    }
+    x                       = (FLASH_Xfer_t){ .Cmd = AT45_BF1TOMNE, .AddrLen = 3,  // 0x83 - "программирование из буфера 1 со стиранием"
+                                              .Addr = Flash_PageAddr (dev, page, 0) };
+    ok                      = ok && Flash_Xfer (dev, &x);
+    Flash_SetPending        (dev, FLASH_OP_PROGRAM, page, 1, dev->Desc.TppMs, dev->Desc.TppMaxMs);  // завершения не ждём: его дождётся следующая операция
+    return ok;
+}
+
+static bool Flash_ProgPage (FLASH_t *dev, uint32_t page, uint32_t offset,       // функция программирования части страницы без обращения к кэшу (кэш пишет через неё свои строки)
+                                                    uint32_t size, uint8_t *buf)
+{                                                                               // результат: false - м/сх не опознана или ошибка обмена
+    bool                    ok = false;
+    if (page >= dev->Pages)                                                     // страница вне м/сх: адрес команды иначе попал бы в другую страницу
+        return false;
+    if (dev->Stripe[0])                                                         // виртуальное устройство: страница на м/сх по чётности номера
+    {
+        Flash_Lock          (dev);                                              // захват виртуального устройства, затем м/сх - как в Flash_StripeWrite
+        ok                  = Flash_ProgPage (dev->Stripe[page & 1], page >> 1, offset, size, buf);
+        Flash_Unlock        (dev);
+    }
+    else if (dev->Id && offset < FLASH_PGSIZE (dev))                            // когда м/сх памяти опознана ->
+    {
+        FLASH_STAT_BEGIN    (t0);
+        Flash_Lock          (dev);                                              // захват м/сх памяти
+        if (size > FLASH_PGSIZE (dev) - offset)                                 // данные не выходят за конец страницы: W25QXX иначе продолжает запись с начала страницы
+                size = FLASH_PGSIZE (dev) - offset;
+        FLASH_Xfer_t x      = { .Cmd     = dev->Desc.ProgCmd,                   // 0x82 - "программирование основной страницы через буфер 1 со стиранием" / 0x02 (0x12) - "программирование страницы"
+                                .AddrLen = dev->AddrLen, .Addr = Flash_PageAddr (dev, page, offset),
+                                .Dir     = FLASH_DIR_TX, .Buf = buf, .Len = size };
+        Flash_Resume        (dev);                                              // пробуждение микросхемы памяти
+        Flash_WriteEnable   (dev, true);                                        // разрешение записи в память
+        FLASH_Seg_t seg     = { buf, size };
+        if (FLASH_IS_AT45 (dev) && (size < FLASH_PGSIZE (dev) || dev->WriteAvoid))  // AT45DBXXX, часть страницы: остальные байты страницы сохраняются
+            ok              = Flash_At45Update (dev, page, offset, &seg, 1);    // (или режим исключения лишних записей: сравнение силами м/сх)
+        else if (dev->WriteAvoid && Flash_ReadCompare (dev, x.Addr, buf, size)) // W25QXX: данные на м/сх уже такие -> программирование не нужно
+        {
+            dev->SkippedWrites++;
+            ok              = true;
+        }
+        else
+        {
+            ok              = Flash_WriteLatch (dev) &&                         // W25QXX: 0x06 - "разрешение записи"
+                              Flash_Xfer (dev, &x);                             // заголовок и массив данных - в одном Chip Select
+            Flash_SetPending (dev, FLASH_OP_PROGRAM, page, 1, dev->Desc.TppMs, dev->Desc.TppMaxMs);  // завершения не ждём: его дождётся следующая операция
+        }
+        Flash_WriteEnable   (dev, false);                                       // запрет записи в память
+        FLASH_STAT_END      (FLASH_STAT_PROGRAM, t0, size);
+        Flash_Unlock        (dev);                                              // освобождение м/сх памяти
+    }
+    return ok;
+}
+
+bool Flash_WritePage        (FLASH_t *dev, uint32_t page, uint32_t offset,      // функция записи данных на микросхему Flash-памяти в указанную страницу с заданным смещением
+                                                    uint32_t size, uint8_t *buf)
+{                                                                               // строка кэша со страницей удаляется: следующее чтение через кэш получит записанные данные
+    Flash_CacheInvalidate   (dev, page, 1);
+    return Flash_ProgPage   (dev, page, offset, size, buf);                     // результат: false - м/сх не опознана или ошибка обмена
+}
+
+bool Flash_UpdatePage       (FLASH_t *dev, uint32_t page, uint32_t offset,      // функция частичного обновления страницы: байты вне [offset, offset + size) сохраняются
+                                                    uint32_t size, uint8_t *buf)
+{                                                                               // только AT45DBXXX: страница загружается в SRAM-буфер, изменяется и программируется обратно
+    bool                    ok = false;
+    Flash_CacheInvalidate   (dev, page, 1);                                     // строка кэша со страницей устаревает
+    if (dev->Stripe[0])                                                         // виртуальное устройство: страница на м/сх по чётности номера
+        return Flash_UpdatePage (dev->Stripe[page & 1], page >> 1, offset, size, buf);
+    if (FLASH_IS_AT45 (dev) && page < dev->Pages && offset < FLASH_PGSIZE (dev))
+    {
+        if (size > FLASH_PGSIZE (dev) - offset)                                 // изменение не выходит за пределы страницы
+            size            = FLASH_PGSIZE (dev) - offset;
+        FLASH_STAT_BEGIN    (t0);
+        Flash_Lock          (dev);                                              // захват м/сх памяти
+        Flash_Resume        (dev);                                              // пробуждение микросхемы памяти
+        Flash_WriteEnable   (dev, true);                                        // разрешение записи в память
+        FLASH_Seg_t seg     = { buf, size };
+        ok                  = Flash_At45Update (dev, page, offset, &seg, 1);
+        Flash_WriteEnable   (dev, false);                                       // запрет записи в память
+        FLASH_STAT_END      (FLASH_STAT_PROGRAM, t0, size);
+        Flash_Unlock        (dev);                                              // освобождение м/сх памяти
+    }
+    return ok;
+}
+
+bool Flash_WriteV           (FLASH_t *dev, uint32_t page, uint32_t offset,      // функция записи в страницу массива, собранного из сегментов (например, заголовок и данные записи)
+                                                    const FLASH_Seg_t *seg, uint8_t count)
+{                                                                               // сегменты идут подряд с offset в одной команде: промежуточный буфер размером со страницу не нужен
+    bool                    ok = false;
+    uint32_t  size          = Flash_SegLen (seg, count);
+    Flash_CacheInvalidate   (dev, page, 1);                                     // строка кэша со страницей устаревает
+    if (dev->Stripe[0])                                                         // виртуальное устройство: страница на м/сх по чётности номера
+        return Flash_WriteV (dev->Stripe[page & 1], page >> 1, offset, seg, count);
+    if (dev->Id && page < dev->Pages && offset < FLASH_PGSIZE (dev) && size && size <= FLASH_PGSIZE (dev) - offset)  // массив не выходит за конец страницы
+    {
+        FLASH_STAT_BEGIN    (t0);
+        Flash_Lock          (dev);                                              // захват м/сх памяти
+        Flash_Resume        (dev);                                              // пробуждение микросхемы памяти
+        Flash_WriteEnable   (dev, true);                                        // разрешение записи в память
+        FLASH_Xfer_t x      = { .Cmd     = dev->Desc.ProgCmd,                   // 0x02 (0x12) - "программирование страницы"
+                                .AddrLen = dev->AddrLen, .Addr = Flash_PageAddr (dev, page, offset),
+                                .Dir     = FLASH_DIR_TX };
+        bool      same      = dev->WriteAvoid && !FLASH_IS_AT45 (dev);
+        uint32_t  addr      = x.Addr;
+        for (uint8_t i = 0; same && i < count; addr += seg[i++].Len)            // W25QXX: данные на м/сх уже такие -> программирование не нужно
+            same            = Flash_ReadCompare (dev, addr, seg[i].Buf, seg[i].Len);
+        if (FLASH_IS_AT45 (dev))                                                // AT45DBXXX: сегменты собираются в SRAM-буфере, остальные байты страницы сохраняются
+            ok              = Flash_At45Update (dev, page, offset, seg, count);
+        else if (same)
+        {
+            dev->SkippedWrites++;
+            ok              = true;
+        }
+        else
+        {
+#if (_FLASH_USE_QSPI == 1)
+            ok              = true;
+            for (uint8_t i = 0; ok && i < count; i++)                           // QUADSPI: команда программирования на сегмент
+                if (seg[i].Len)
+                {
+                    x.Buf   = seg[i].Buf;
+                    x.Len   = seg[i].Len;
+                    Flash_WaitPending (dev);                                    // ожидание окончания программирования предыдущего сегмента
+                    ok      = Flash_WriteLatch (dev) && Flash_Xfer (dev, &x);
+                    Flash_SetPending (dev, FLASH_OP_PROGRAM, page, 1, dev->Desc.TppMs, dev->Desc.TppMaxMs);
+                    x.Addr += seg[i].Len;
+                }
+#else
+            ok              = Flash_WriteLatch (dev) && Flash_XferV (dev, &x, seg, count);  // W25QXX: 0x06 - "разрешение записи", затем заголовок и все сегменты
+            Flash_SetPending (dev, FLASH_OP_PROGRAM, page, 1, dev->Desc.TppMs, dev->Desc.TppMaxMs);  // завершения не ждём: его дождётся следующая операция
+#endif
+        }
+        Flash_WriteEnable   (dev, false);                                       // запрет записи в память
+        FLASH_STAT_END      (FLASH_STAT_PROGRAM, t0, size);
+        Flash_Unlock        (dev);                                              // освобождение м/сх памяти
+    }
+    return ok;
+}
+
+static bool Flash_ProgPages (FLASH_t *dev, uint32_t page, uint32_t count, uint8_t *buf)  // функция программирования целых страниц без обращения к кэшу
+{                                                                               // AT45DBXXX: пока один SRAM-буфер программируется в основную память, второй заполняется по SPI
+    bool                    ok = false;
+    if (dev->Stripe[0])
+        return Flash_StripeWrite (dev, page, count, buf);
+    if (dev->Id && count && page < dev->Pages && count <= dev->Pages - page)    // когда м/сх памяти опознана и страницы в пределах м/сх ->
+    {
+        FLASH_STAT_BEGIN    (t0);
+        Flash_Lock          (dev);                                              // захват м/сх памяти
+        Flash_Resume        (dev);                                              // пробуждение микросхемы памяти
+        Flash_WriteEnable   (dev, true);                                        // разрешение записи в память
+        ok                  = true;
+        for (uint32_t i = 0; ok && i < count; i++, buf += FLASH_PGSIZE (dev))
+        {
+            if (FLASH_IS_AT45 (dev))                                            // при работе с AT45DBXX -> буферы 1 и 2 поочерёдно
+            {
+                bool  bf2   = i & 1;
+                FLASH_Xfer_t x  = { .Cmd     = bf2 ? AT45_WRBF2 : AT45_WRBF1,   // 0x84/0x87 - "запись буфера 1/2"
+                                    .AddrLen = 3, .Addr = 0,                    // 15 фиктивных бит + адрес начала в буфере
+                                    .Dir     = FLASH_DIR_TX, .Buf = buf, .Len = FLASH_PGSIZE (dev) };
+                ok          = Flash_Xfer (dev, &x);                             // заполнение буфера, пока другой буфер программируется
+                Flash_WaitPending (dev);                                        // ожидание окончания программирования предыдущей страницы
+                x           = (FLASH_Xfer_t){ .Cmd  = bf2 ? AT45_BF2TOMNE : AT45_BF1TOMNE,  // 0x83/0x86 - "программирование из буфера 1/2 со стиранием"
+                                              .AddrLen = 3, .Addr = Flash_PageAddr (dev, page + i, 0) };
+                ok          = ok && Flash_Xfer (dev, &x);
+                Flash_SetPending (dev, FLASH_OP_PROGRAM, page + i, 1, dev->Desc.TppMs, dev->Desc.TppMaxMs);
+            }
+            else                                                                // при работе с W25QXX -> программирование страниц по очереди
+            {
+                FLASH_Xfer_t x  = { .Cmd     = dev->Desc.ProgCmd,               // 0x02 (0x12) - "программирование страницы"
+                                    .AddrLen = dev->AddrLen, .Addr = Flash_PageAddr (dev, page + i, 0),
+                                    .Dir     = FLASH_DIR_TX, .Buf = buf, .Len = FLASH_PGSIZE (dev) };
+                Flash_WaitPending (dev);                                        // ожидание окончания программирования предыдущей страницы
+                ok          = Flash_WriteLatch (dev) && Flash_Xfer (dev, &x);
+                Flash_SetPending (dev, FLASH_OP_PROGRAM, page + i, 1, dev->Desc.TppMs, dev->Desc.TppMaxMs);
+            }
+        }
+        Flash_WriteEnable   (dev, false);                                       // запрет записи в память
+        FLASH_STAT_END      (FLASH_STAT_PROGRAM, t0, count * FLASH_PGSIZE (dev));
+        Flash_Unlock        (dev);                                              // освобождение м/сх памяти
+    }
+    return ok;
+}
+
+bool Flash_WritePages       (FLASH_t *dev, uint32_t page, uint32_t count, uint8_t *buf)  // функция последовательной записи нескольких целых страниц, начиная с указанной
+{                                                                               // строки кэша с этими страницами удаляются
+    Flash_CacheInvalidate   (dev, page, count);
+    return Flash_ProgPages  (dev, page, count, buf);
+}
+
+bool Flash_Write            (FLASH_t *dev, uint32_t addr, uint32_t len, const uint8_t *buf)  // функция записи произвольного массива данных по линейному адресу (область должна быть стёрта)
+{                                                                               // массив делится по границам страниц м/сх (2^n или 264/528/1056 байт у AT45DBXXX)
+    uint32_t  total         = dev->Pages * FLASH_PGSIZE (dev);
+    bool                    ok = dev->Id && addr < total && len <= total - addr;  // когда м/сх памяти опознана и массив в пределах м/сх ->
+    while (ok && len)
+    {
+        uint32_t  page      = addr / FLASH_PGSIZE (dev), offset = addr % FLASH_PGSIZE (dev);
+        uint32_t  n         = FLASH_PGSIZE (dev) - offset < len ? FLASH_PGSIZE (dev) - offset : len;
+        if (!offset && len >= FLASH_PGSIZE (dev))                               // целые страницы подряд: следующая передаётся, пока программируется предыдущая
+        {
+            n               = len - len % FLASH_PGSIZE (dev);
+            ok              = Flash_WritePages (dev, page, n / FLASH_PGSIZE (dev), (uint8_t*)buf);
+        }
+        else                                                                    // начало или конец массива - часть страницы
+            ok              = Flash_WritePage (dev, page, offset, n, (uint8_t*)buf);
+        addr               += n;
+        buf                += n;
+        len                -= n;
+    }
+    return ok;
+}
+
+void Flash_ReadPage         (FLASH_t *dev, uint32_t page, uint32_t offset,      // функция чтения данных из микросхемы Flash-памяти с указанной страницы с заданным смещением
+                                                    uint32_t size, uint8_t *buf)
+{
+    if (dev->Stripe[0])                                                         // виртуальное устройство: страница на м/сх по чётности номера
+        Flash_ReadPage      (dev->Stripe[page & 1], page >> 1, offset, size, buf);
+    else if (dev->Id)                                                           // когда м/сх памяти опознана ->
+    {
+        FLASH_STAT_BEGIN    (t0);
+        Flash_Lock          (dev);                                              // захват м/сх памяти
+        if (size > FLASH_PGSIZE (dev))                                          // проверка размера блока
+                size = FLASH_PGSIZE (dev);
+        if (!Flash_PrefetchRead (dev, page * FLASH_PGSIZE (dev) + offset, size, buf))  // страница не принята заранее -> чтение с м/сх
+        {
+            Flash_PrepareRead (dev, page, 1);                                   // приостановка программирования/стирания других страниц или ожидание его завершения
+            Flash_ReadArray (dev, Flash_PageAddr (dev, page, offset), buf, size);  // 0x0B + адрес + фиктивный байт, затем запрошенный массив данных
+            Flash_FinishRead (dev);                                             // возобновление приостановленной операции
+        }
+        Flash_PrefetchNext  (dev, page * FLASH_PGSIZE (dev) + offset, size);    // чтения идут подряд -> приём следующих страниц
+        FLASH_STAT_END      (FLASH_STAT_READ, t0, size);
+        Flash_Unlock        (dev);                                              // освобождение м/сх памяти
+    }
+}
+
+bool Flash_Read             (FLASH_t *dev, uint32_t addr, uint32_t len, uint8_t *buf)  // функция потокового чтения произвольного массива данных по линейному адресу
+{                                                                               // один заголовок команды на весь массив: м/сх сама переходит через границы страниц
+    bool                    ok = false;
+    if (dev->Stripe[0])
+        return Flash_StripeRead (dev, addr, len, buf);
+    if (dev->Id && len && addr < dev->Pages * FLASH_PGSIZE (dev))               // когда м/сх памяти опознана и адрес в пределах м/сх ->
+    {
+        if (len > dev->Pages * FLASH_PGSIZE (dev) - addr)                       // ограничение чтения концом м/сх
+            len             = dev->Pages * FLASH_PGSIZE (dev) - addr;
+        FLASH_STAT_BEGIN    (t0);
+        Flash_Lock          (dev);                                              // захват м/сх памяти
+        ok                  = Flash_PrefetchRead (dev, addr, len, buf);         // массив принят заранее -> без обмена с м/сх
+        if (!ok)
+        {
+            Flash_PrepareRead (dev, addr / FLASH_PGSIZE (dev),                  // приостановка программирования/стирания других страниц или ожидание его завершения
+                                    (addr + len - 1) / FLASH_PGSIZE (dev) - addr / FLASH_PGSIZE (dev) + 1);
+            ok              = Flash_ReadArray (dev, FLASH_LINEAR (dev) ? addr : // страница 2^n байт: адрес без пересчёта
+                                               Flash_PageAddr (dev, addr / FLASH_PGSIZE (dev), addr % FLASH_PGSIZE (dev)), buf, len);
+            Flash_FinishRead (dev);                                             // возобновление приостановленной операции
+        }
+        Flash_PrefetchNext  (dev, addr, len);                                   // чтения идут подряд -> приём следующих страниц
+        FLASH_STAT_END      (FLASH_STAT_READ, t0, len);
+        Flash_Unlock        (dev);                                              // освобождение м/сх памяти
+    }
+    return ok;
+}
+
+bool Flash_ReadV            (FLASH_t *dev, uint32_t addr, const FLASH_Seg_t *seg, uint8_t count)  // функция чтения массива по линейному адресу в несколько буферов (сегментов)
+{                                                                               // один заголовок команды: сегменты принимаются друг за другом в одном Chip Select
+    bool                    ok = false;
+    uint32_t  len           = Flash_SegLen (seg, count);
+    if (dev->Stripe[0])                                                         // виртуальное устройство: сегменты читаются по очереди
+    {
+        ok                  = len != 0;
+        for (uint8_t i = 0; ok && i < count; addr += seg[i++].Len)
+            ok              = !seg[i].Len || Flash_Read (dev, addr, seg[i].Len, seg[i].Buf);
+        return ok;
+    }
+    if (dev->Id && len && addr < dev->Pages * FLASH_PGSIZE (dev) && len <= dev->Pages * FLASH_PGSIZE (dev) - addr)  // когда м/сх памяти опознана и массив в пределах м/сх ->
+    {
+        FLASH_STAT_BEGIN    (t0);
+        Flash_Lock          (dev);                                              // захват м/сх памяти
+        Flash_PrepareRead   (dev, addr / FLASH_PGSIZE (dev),                    // приостановка программирования/стирания других страниц или ожидание его завершения
+                                  (addr + len - 1) / FLASH_PGSIZE (dev) - addr / FLASH_PGSIZE (dev) + 1);
+#if (_FLASH_USE_QSPI == 1)
+        ok                  = true;
+        for (uint8_t i = 0; ok && i < count; addr += seg[i++].Len)              // QUADSPI: команда чтения на сегмент
+            ok              = !seg[i].Len || Flash_ReadArray (dev, FLASH_LINEAR (dev) ? addr :
+                                               Flash_PageAddr (dev, addr / FLASH_PGSIZE (dev), addr % FLASH_PGSIZE (dev)), seg[i].Buf, seg[i].Len);
+#else
+        FLASH_Xfer_t x      = Flash_ReadCmd (dev, FLASH_LINEAR (dev) ? addr :   // страница 2^n байт: адрес без пересчёта
+                                             Flash_PageAddr (dev, addr / FLASH_PGSIZE (dev), addr % FLASH_PGSIZE (dev)));
+        ok                  = Flash_XferV (dev, &x, seg, count);
+#endif
+        Flash_FinishRead    (dev);                                              // возобновление приостановленной операции
+        FLASH_STAT_END      (FLASH_STAT_READ, t0, len);
+        Flash_Unlock        (dev);                                              // освобождение м/сх памяти
+    }
+    return ok;
+}
+
+// ------------------------------- Планировщик запросов нескольких задач: ------------------------------------------------------------
+// задачи ставят запросы в общую очередь, выполняет их отдельная задача драйвера. чтения обслуживаются раньше записей и стираний
+// (если старейший запрос ждёт меньше _FLASH_SCHED_AGE_MS), пересекающиеся и соседние чтения объединяются в одну команду чтения,
+// записи с продолжением адреса - в одну запись. запрос не обгоняет более ранний запрос, с которым пересекается (кроме двух чтений).
+
+#if (_FLASH_USE_SCHED == 1 && _FLASH_USE_FREERTOS == 1)
+static FLASH_Req_t         *flashSchedHead;                                     // очередь запросов в порядке поступления
+static SemaphoreHandle_t    flashSchedMutex;                                    // мьютекс очереди
+static TaskHandle_t         flashSchedTask;                                     // задача планировщика
+static uint8_t              flashSchedBuf[_FLASH_SCHED_MERGE];                  // буфер объединённой команды
+#endif
+FLASH_SchedStats_t          flashSchedStats;                                    // статистика планировщика
+
+static bool Flash_SchedExec (FLASH_Req_t *req)                                  // функция выполнения одиночного запроса
+{
+    switch (req->Op)
+    {
+        case FLASH_REQ_READ:    return Flash_Read       (req->Dev, req->Addr, req->Len, req->Buf);
+        case FLASH_REQ_WRITE:   return Flash_Write      (req->Dev, req->Addr, req->Len, req->Buf);
+        case FLASH_REQ_ERASE:   return Flash_EraseRange (req->Dev, req->Addr, req->Len);
+        default:                return false;
+    }
+}
+
+static void Flash_SchedDone (FLASH_Req_t *req, bool ok)                         // функция завершения запроса: результат и уведомление задачи
+{
+    void                   *task = req->Notify;                                 // после Done память запроса может быть использована задачей
+    req->Ok                 = ok;
+    req->Done               = true;
+    flashSchedStats.Completed++;
+#if (_FLASH_USE_FREERTOS == 1)
+    if (task != NULL)
+        xTaskNotifyGiveIndexed ((TaskHandle_t)task, _FLASH_NOTIFY_INDEX);
+#else
+    (void)task;
+#endif
+}
+
+#if (_FLASH_USE_SCHED == 1 && _FLASH_USE_FREERTOS == 1)
+static void Flash_SchedSpan (const FLASH_Req_t *r, uint32_t *lo, uint32_t *hi)  // функция расчёта затрагиваемого запросом диапазона: стирание - до границ стираемых блоков
+{
+    uint32_t  block         = r->Dev->ErasableSize ? r->Dev->ErasableSize : 1;
+    *lo                     = r->Addr;
+    *hi                     = r->Addr + r->Len;
+    if (r->Op == FLASH_REQ_ERASE)
+    {
+        *lo                -= *lo % block;
+        *hi                 = (*hi + block - 1) / block * block;
+    }
+}
+
+static bool Flash_SchedBlocked (const FLASH_Req_t *req)                         // функция проверки: запрос пересекается с более ранним запросом той же м/сх (кроме двух чтений)
+{
+    uint32_t  lo, hi, l, h;
+    Flash_SchedSpan         (req, &lo, &hi);
+    for (const FLASH_Req_t *r = flashSchedHead; r != req; r = r->Next)
+    {
+        Flash_SchedSpan     (r, &l, &h);
+        if (r->Dev == req->Dev && (r->Op != FLASH_REQ_READ || req->Op != FLASH_REQ_READ) && l < hi && lo < h)
+            return true;
+    }
+    return false;
+}
+
+static uint8_t Flash_SchedPick (FLASH_Req_t **batch)                            // функция выбора следующей команды: запрос и присоединяемые к нему запросы (извлекаются из очереди)
+{
+    FLASH_Req_t *req        = flashSchedHead;
+    uint8_t                 n = 0;
+    if (req == NULL)
+        return 0;
+    if (_FLASH_TICK () - req->Queued < _FLASH_SCHED_AGE_MS)                     // старейший запрос ждёт недолго -> первым - чтение, которому ничто не мешает
+        for (FLASH_Req_t *r = req; r; r = r->Next)
+            if (r->Op == FLASH_REQ_READ && !Flash_SchedBlocked (r))
+            {
+                req         = r;
+                break;
+            }
+    batch[n++]              = req;
+    uint32_t  lo            = req->Addr, hi = req->Addr + req->Len;
+    for (bool grown = req->Op != FLASH_REQ_ERASE; grown; )                      // присоединение, пока диапазон растёт
+    {
+        grown               = false;
+        for (FLASH_Req_t *r = flashSchedHead; r && n < _FLASH_SCHED_BATCH; r = r->Next)
+        {
+            bool  taken     = false;
+            for (uint8_t i = 0; i < n; i++)
+                taken      |= batch[i] == r;
+            uint32_t  l     = r->Addr < lo ? r->Addr : lo;
+            uint32_t  h     = r->Addr + r->Len > hi ? r->Addr + r->Len : hi;
+            bool  fit       = req->Op == FLASH_REQ_READ ? r->Addr <= hi && lo <= r->Addr + r->Len  // чтение: пересечение или соседство
+                                                        : r->Addr == hi;        // запись: продолжение
+            if (!taken && r->Dev == req->Dev && r->Op == req->Op && fit && h - l <= _FLASH_SCHED_MERGE && !Flash_SchedBlocked (r))
+            {
+                batch[n++]  = r;
+                lo          = l;
+                hi          = h;
+                grown       = true;
+            }
+        }
+    }
+    for (uint8_t i = 0; i < n; i++)                                             // извлечение из очереди
+    {
+        FLASH_Req_t **p     = &flashSchedHead;
+        while (*p != batch[i])
+            p               = &(*p)->Next;
+        *p                  = batch[i]->Next;
+    }
+    flashSchedStats.Depth  -= n;
+    return n;
+}
+
+static void Flash_SchedRun  (FLASH_Req_t **batch, uint8_t n)                    // функция выполнения команды из одного или нескольких запросов
+{
+    FLASH_Req_t *req        = batch[0];
+    uint32_t  lo            = req->Addr, hi = req->Addr + req->Len;
+    uint32_t  now           = _FLASH_TICK ();
+    bool                    ok;
+    for (uint8_t i = 0; i < n; i++)
+    {
+        uint32_t  wait      = now - batch[i]->Queued;                           // ожидание в очереди
+        flashSchedStats.WaitSumMs += wait;
+        flashSchedStats.WaitMaxMs  = wait > flashSchedStats.WaitMaxMs ? wait : flashSchedStats.WaitMaxMs;
+        lo                  = batch[i]->Addr < lo ? batch[i]->Addr : lo;
+        hi                  = batch[i]->Addr + batch[i]->Len > hi ? batch[i]->Addr + batch[i]->Len : hi;
+    }
+    flashSchedStats.Commands++;
+    if (n == 1)
+        ok                  = Flash_SchedExec (req);
+    else if (req->Op == FLASH_REQ_READ)                                         // одно непрерывное чтение, затем раздача по буферам запросов
+    {
+        ok                  = Flash_Read (req->Dev, lo, hi - lo, flashSchedBuf);
+        for (uint8_t i = 0; ok && i < n; i++)
+            memcpy          (batch[i]->Buf, &flashSchedBuf[batch[i]->Addr - lo], batch[i]->Len);
+        flashSchedStats.MergedReads += n - 1;
+    }
+    else                                                                        // сборка записей в один массив: деление только по границам страниц
+    {
+        for (uint8_t i = 0; i < n; i++)
+            memcpy          (&flashSchedBuf[batch[i]->Addr - lo], batch[i]->Buf, batch[i]->Len);
+        ok                  = Flash_Write (req->Dev, lo, hi - lo, flashSchedBuf);
+        flashSchedStats.MergedWrites += n - 1;
+    }
+    for (uint8_t i = 0; i < n; i++)
+        Flash_SchedDone     (batch[i], ok);
+}
+
+static void Flash_SchedThread (void *arg)                                       // задача планировщика: выполнение очереди запросов
+{
+    FLASH_Req_t *batch[_FLASH_SCHED_BATCH];
+    (void)arg;
+    for (;;)
+    {
+        xSemaphoreTake      (flashSchedMutex, portMAX_DELAY);
+        uint8_t   n         = Flash_SchedPick (batch);
+        xSemaphoreGive      (flashSchedMutex);
+        if (n)                                                                  // команда выполняется без мьютекса очереди: задачи ставят новые запросы
+            Flash_SchedRun  (batch, n);
+        else
+            ulTaskNotifyTake (pdTRUE, portMAX_DELAY);                           // очередь пуста: ожидание запроса
+    }
+}
+#endif
+
+bool Flash_SchedInit        (void)                                              // функция запуска задачи планировщика (после Flash_Init устройств)
+{
+#if (_FLASH_USE_SCHED == 1 && _FLASH_USE_FREERTOS == 1)
+    if (flashSchedMutex != NULL && flashSchedTask == NULL)                      // мьютекс очереди создан Flash_Init
+        xTaskCreate         (Flash_SchedThread, "flashSched", _FLASH_SCHED_STACK, NULL, _FLASH_SCHED_PRIORITY, &flashSchedTask);
+    return flashSchedTask != NULL;
+#else
+    return false;
+#endif
+}
+
+bool Flash_Submit           (FLASH_Req_t *req)                                  // функция постановки запроса в очередь планировщика без ожидания
+{                                                                               // завершение: req->Done и уведомление задачи req->Notify; без планировщика запрос выполняется сразу
+    req->Done               = false;
+    req->Ok                 = false;
+#if (_FLASH_USE_SCHED == 1 && _FLASH_USE_FREERTOS == 1)
+    if (flashSchedTask != NULL)
+    {
+        FLASH_Req_t **p     = &flashSchedHead;
+        req->Next           = NULL;
+        req->Queued         = _FLASH_TICK ();
+        xSemaphoreTake      (flashSchedMutex, portMAX_DELAY);
+        while (*p != NULL)                                                      // в конец очереди
+            p               = &(*p)->Next;
+        *p                  = req;
+        flashSchedStats.Submitted++;
+        if (++flashSchedStats.Depth > flashSchedStats.MaxDepth)
+            flashSchedStats.MaxDepth = flashSchedStats.Depth;
+        xSemaphoreGive      (flashSchedMutex);
+        xTaskNotifyGive     (flashSchedTask);
+        return true;
+    }
+#endif
+    flashSchedStats.Submitted++;
+    flashSchedStats.Commands++;
+    Flash_SchedDone         (req, Flash_SchedExec (req));
+    return true;
+}
+
+bool Flash_SubmitWait       (FLASH_Req_t *req)                                  // функция выполнения запроса через планировщик с ожиданием завершения
+{
+#if (_FLASH_USE_SCHED == 1 && _FLASH_USE_FREERTOS == 1)
+    req->Notify             = flashSchedTask != NULL ? xTaskGetCurrentTaskHandle () : NULL;  // без задачи планировщика запрос выполняется сразу
+    Flash_Submit            (req);
+    while (!req->Done)                                                          // своё уведомление: задача может ждать и другие (индекс 0)
+        ulTaskNotifyTakeIndexed (_FLASH_NOTIFY_INDEX, pdTRUE, portMAX_DELAY);
+#else
+    req->Notify             = NULL;
+    Flash_Submit            (req);
+#endif
+    return req->Ok;
+}
+
+// ------------------------------- Кэш страниц для функций-прокладок LittleFS: ----------------------------------------------------------
+// кэш с отложенной записью: чтения из кэшированных страниц не обращаются к шине, частичные записи в одну страницу объединяются,
+// запись на м/сх происходит при вытеснении страницы (LRU) и в block_device_sync. строки общие для всех устройств, страница
+// помечается своим устройством; несколько экземпляров LittleFS в разных задачах сериализуются мьютексом кэша.
+// прямые записи и стирания удаляют строки своих страниц, поэтому кэш пишет строки на м/сх через Flash_ProgPage/Flash_ProgPages.
+
+#if (_FLASH_CACHE_PAGES > 0)
+typedef struct
+{
+    FLASH_t    *Dev;                                                            // устройство кэшированной страницы
+    uint32_t    Page;                                                           // номер кэшированной страницы
+    uint32_t    Stamp;                                                          // момент последнего обращения (для вытеснения LRU)
+    bool        Valid;                                                          // строка содержит страницу
+    bool        Dirty;                                                          // строка изменена и не записана на м/сх
+    uint8_t     Data[_FLASH_CACHE_PGSIZE];                                      // содержимое страницы
+} FLASH_CacheLine_t;
+
+static FLASH_CacheLine_t    flashCache[_FLASH_CACHE_PAGES];                     // строки кэша
+static uint32_t             flashCacheClock;                                    // счётчик обращений к кэшу
+#if (_FLASH_USE_FREERTOS == 1)
+static SemaphoreHandle_t    flashCacheMutex;                                    // мьютекс кэша
+#endif
+#endif
+FLASH_CacheStats_t          flashCacheStats;                                    // статистика работы кэша
+
+static bool Flash_MutexInit (FLASH_t *own)                                      // функция создания мьютекса устройства (владельца шины), очереди планировщика и кэша
+{                                                                               // вызывается из Flash_Init до того, как устройство захватывают задачи
+#if (_FLASH_USE_FREERTOS == 1)
+    if (own->Mutex == NULL)
+        own->Mutex          = xSemaphoreCreateMutex ();
+#if (_FLASH_USE_SCHED == 1)
+    if (flashSchedMutex == NULL)
+        flashSchedMutex     = xSemaphoreCreateMutex ();
+    if (flashSchedMutex == NULL)
+        return false;
+#endif
+#if (_FLASH_CACHE_PAGES > 0)
+    if (flashCacheMutex == NULL)
+        flashCacheMutex     = xSemaphoreCreateMutex ();
+    if (flashCacheMutex == NULL)
+        return false;
+#endif
+    return own->Mutex != NULL;
+#else
+    (void)own;
+    return true;
+#endif
+}
+
+#if (_FLASH_CACHE_PAGES > 0)
+static void Flash_CacheLock (void)                                              // функция захвата кэша задачей
+{
+#if (_FLASH_USE_FREERTOS == 1)
+    xSemaphoreTake          (flashCacheMutex, portMAX_DELAY);
+#endif
+}
+
+static void Flash_CacheUnlock (void)                                            // функция освобождения кэша
+{
+#if (_FLASH_USE_FREERTOS == 1)
+    xSemaphoreGive          (flashCacheMutex);
+#endif
+}
+
+static bool Flash_CacheWriteBack (FLASH_CacheLine_t *line)                      // функция записи изменённой строки кэша на м/сх
+{                                                                               // ошибка записи -> строка остаётся изменённой: её запишет следующая синхронизация
+    if (line->Valid && line->Dirty)
+    {
+        if (!Flash_ProgPage (line->Dev, line->Page, 0, line->Dev->PgSize, line->Data))  // страница программируется целиком
+            return false;
+        line->Dirty         = false;
+        flashCacheStats.WriteBacks++;
+    }
+    return true;
+}
+
+static FLASH_CacheLine_t *Flash_CacheFind (FLASH_t *dev, uint32_t page)         // функция поиска страницы в кэше без загрузки (NULL - страницы в кэше нет)
+{
+    for (uint32_t i = 0; i < _FLASH_CACHE_PAGES; i++)
+        if (flashCache[i].Valid && flashCache[i].Dev == dev && flashCache[i].Page == page)
+            return &flashCache[i];
+    return NULL;
+}
+
+static uint32_t Flash_CacheRun (FLASH_t *dev, uint32_t page, uint32_t offset, uint32_t size)  // функция подсчёта целых страниц подряд, которых нет в кэше
+{                                                                               // такие страницы передаются мимо кэша одной командой
+    uint32_t                run = 0;
+    if (offset == 0)
+        while ((run + 1) * FLASH_PGSIZE (dev) <= size && !Flash_CacheFind (dev, page + run))
+            run++;
+    return run;
+}
+
+static FLASH_CacheLine_t *Flash_CacheGet (FLASH_t *dev, uint32_t page)          // функция поиска страницы в кэше с загрузкой при промахе
+{                                                                               // NULL - вытесняемую строку не удалось записать на м/сх (строка сохраняется) или страница не прочитана
+    FLASH_CacheLine_t *victim = &flashCache[0];
+    for (uint32_t i = 0; i < _FLASH_CACHE_PAGES; i++)
+    {
+        FLASH_CacheLine_t *line = &flashCache[i];
+        if (line->Valid && line->Dev == dev && line->Page == page)              // попадание
+        {
+            line->Stamp     = ++flashCacheClock;
+            flashCacheStats.Hits++;
+            return line;
+        }
+        if (!line->Valid || (victim->Valid && line->Stamp < victim->Stamp))     // кандидат на вытеснение: свободная строка или давно не используемая
+            victim          = line;
+    }
+    flashCacheStats.Misses++;
+    if (victim->Valid)                                                          // вытеснение занятой строки
+    {
+        if (!Flash_CacheWriteBack (victim))
+            return NULL;
+        flashCacheStats.Evictions++;
+    }
+    if (!Flash_Read (dev, page * FLASH_PGSIZE (dev), FLASH_PGSIZE (dev), victim->Data))  // загрузка страницы целиком
+    {
+        victim->Valid       = false;                                            // ошибка чтения: содержимое строки не годится ни для какой страницы
+        return NULL;
+    }
+    victim->Dev             = dev;
+    victim->Page            = page;
+    victim->Valid           = true;
+    victim->Dirty           = false;
+    victim->Stamp           = ++flashCacheClock;
+    return victim;
+}
+#endif
+
+bool Flash_CacheRead        (FLASH_t *dev, uint32_t page, uint32_t offset,      // функция чтения данных через кэш страниц
+                                                    uint32_t size, uint8_t *buf)
+{                                                                               // целые страницы, которых нет в кэше, читаются одной непрерывной командой мимо кэша
+    bool                    ok = dev->Id && page < dev->Pages && offset < FLASH_PGSIZE (dev) &&
+                                 size <= (dev->Pages - page) * FLASH_PGSIZE (dev) - offset;  // когда м/сх опознана и массив в пределах м/сх ->
+#if (_FLASH_CACHE_PAGES > 0)
+    if (ok && FLASH_PGSIZE (dev) <= _FLASH_CACHE_PGSIZE)
+    {
+        Flash_CacheLock     ();
+        while (ok && size)                                                      // данные могут занимать несколько страниц
+        {
+            uint32_t  run   = Flash_CacheRun (dev, page, offset, size);
+            uint32_t  n     = FLASH_PGSIZE (dev) - offset < size ? FLASH_PGSIZE (dev) - offset : size;
+            if (run)                                                            // целые страницы мимо кэша: чтение не вытесняет строки
+            {
+                n           = run * FLASH_PGSIZE (dev);
+                ok          = Flash_Read (dev, page * FLASH_PGSIZE (dev), n, buf);
+                flashCacheStats.Bypassed += run;
+                page       += run;
+            }
+            else
+            {
+                FLASH_CacheLine_t *line = Flash_CacheGet (dev, page++);
+                ok          = line != NULL;
+                if (ok)
+                    memcpy  (buf, &line->Data[offset], n);
+            }
+            buf            += n;
+            size           -= n;
+            offset          = 0;
+        }
+        Flash_CacheUnlock   ();
+        return ok;
+    }
+#endif
+    return ok && (!size || Flash_Read (dev, page * FLASH_PGSIZE (dev) + offset, size, buf));  // кэш отключён или страница м/сх больше строки кэша: одна команда на весь массив
+}
+
+bool Flash_CacheProg        (FLASH_t *dev, uint32_t page, uint32_t offset,      // функция записи данных через кэш страниц (запись на м/сх откладывается)
+                                                    uint32_t size, const uint8_t *buf)
+{                                                                               // целые страницы, которых нет в кэше, программируются сразу, без загрузки в кэш
+    bool                    ok = dev->Id && page < dev->Pages && offset < FLASH_PGSIZE (dev) &&
+                                 size <= (dev->Pages - page) * FLASH_PGSIZE (dev) - offset;
+#if (_FLASH_CACHE_PAGES > 0)
+    if (ok && FLASH_PGSIZE (dev) <= _FLASH_CACHE_PGSIZE)
+    {
+        Flash_CacheLock     ();
+        while (ok && size)                                                      // деление только по границам страниц м/сх
+        {
+            uint32_t  run   = Flash_CacheRun (dev, page, offset, size);
+            uint32_t  n     = FLASH_PGSIZE (dev) - offset < size ? FLASH_PGSIZE (dev) - offset : size;
+            if (run)                                                            // целые страницы подряд: следующая передаётся, пока программируется предыдущая
+            {
+                n           = run * FLASH_PGSIZE (dev);
+                ok          = Flash_ProgPages (dev, page, run, (uint8_t*)buf);
+                flashCacheStats.Bypassed += run;
+                page       += run;
+            }
+            else                                                                // часть страницы: объединение с ранее записанными данными страницы
+            {
+                FLASH_CacheLine_t *line = Flash_CacheGet (dev, page++);
+                ok          = line != NULL;                                     // вытеснение не удалось -> ошибка записи возвращается вызывающему
+                if (ok)
+                {
+                    memcpy  (&line->Data[offset], buf, n);
+                    line->Dirty = true;
+                }
+            }
+            buf            += n;
+            size           -= n;
+            offset          = 0;
+        }
+        Flash_CacheUnlock   ();
+        return ok;
+    }
+#endif
+    return ok && (!size || Flash_Write (dev, page * FLASH_PGSIZE (dev) + offset, size, buf));  // кэш отключён или страница м/сх больше строки кэша
+}
+
+void Flash_CacheInvalidate  (FLASH_t *dev, uint32_t page, uint32_t count)       // функция удаления из кэша страниц указанной области без записи (перед прямой записью или стиранием)
+{
+#if (_FLASH_CACHE_PAGES > 0)
+    Flash_CacheLock         ();
+    for (uint32_t i = 0; i < _FLASH_CACHE_PAGES; i++)
+        if (flashCache[i].Valid && flashCache[i].Dev == dev && flashCache[i].Page - page < count)
+            flashCache[i].Valid = false;
+    Flash_CacheUnlock       ();
+#else
+    (void)dev;
+    (void)page;
+    (void)count;
+#endif
+}
+
+bool Flash_CacheSync        (FLASH_t *dev)                                      // функция записи всех изменённых страниц устройства из кэша на м/сх
+{                                                                               // результат: false - какую-то страницу записать не удалось (её строка остаётся изменённой)
+    bool                    ok = true;
+#if (_FLASH_CACHE_PAGES > 0)
+    Flash_CacheLock         ();
+    for (uint32_t i = 0; i < _FLASH_CACHE_PAGES; i++)
+        if (flashCache[i].Dev == dev)
+            ok              = Flash_CacheWriteBack (&flashCache[i]) && ok;      // остальные строки записываются и после ошибки
+    flashCacheStats.Syncs++;
+    Flash_CacheUnlock       ();
+#endif
+    Flash_WaitIdle          (dev);                                              // данные гарантированно на м/сх
+    return ok;
+}
+
+// ------------------------------- Слой трансляции блоков (FTL) для функций-прокладок LittleFS: ---------------------------------------
+// логический блок LittleFS отображается на любой физический стираемый блок. стирание логического блока - это выдача из запаса
+// заранее стёртого наименее изношенного блока и запись его заголовка; прежний блок стирает фоновая задача, пока м/сх свободна.
+// последняя страница физического блока - заголовок: слот 0 пишется после стирания (счётчик стираний), слот 1 - при выдаче
+// (номер логического блока и порядковый номер выдачи). при запуске таблица отображения восстанавливается по заголовкам.
+
+#if (_FLASH_USE_FTL == 1)
+#define FLASH_FTL_ERASED        0x45465446                                      // "FTFE": признак слота 0 - блок стёрт
+#define FLASH_FTL_MAPPED        0x4D465446                                      // "FTFM": признак слота 1 - блок выдан логическому блоку
+#define FLASH_FTL_NONE          0xFFFF                                          // логический блок не отображён (читается как стёртый) / блок не выбран
+#if (_FLASH_FTL_BLOCKS >= FLASH_FTL_NONE)
+#error "_FLASH_FTL_BLOCKS: номера физических блоков FTL должны помещаться в uint16_t и отличаться от FLASH_FTL_NONE"
+#endif
+
+typedef enum
+{
+    FLASH_FTL_UNKNOWN       = 0,                                                // заголовок пуст: блок проверяется на стёртость фоновой задачей
+    FLASH_FTL_FREE,                                                             // блок стёрт и лежит в запасе
+    FLASH_FTL_USED,                                                             // блок отображён на логический блок
+    FLASH_FTL_STALE,                                                            // блок устарел и ждёт стирания
+    FLASH_FTL_ERASING,                                                          // блок стирается фоновой задачей
+} FLASH_FtlState_t;
+
+typedef struct                                                                  // слот заголовка физического блока
+{
+    uint32_t    Magic;                                                          // признак слота: FLASH_FTL_ERASED / FLASH_FTL_MAPPED
+    uint32_t    Value;                                                          // слот 0 - счётчик стираний, слот 1 - номер логического блока
+    uint32_t    Seq;                                                            // слот 1 - порядковый номер выдачи: из двух блоков одного логического действует поздний
+    uint32_t    Check;                                                          // контрольное слово: слот, запись которого прервана, не принимается
+} FLASH_FtlSlot_t;
+
+typedef struct FLASH_Ftl_s
+{
+    FLASH_t    *Dev;                                                            // устройство носителя
+    uint16_t    Blocks;                                                         // количество используемых физических блоков
+    uint16_t    Logical;                                                        // количество логических блоков (физические блоки без запаса)
+    uint16_t    PagesPerBlock;                                                  // страниц в физическом блоке, последняя из них - заголовок
+    uint16_t    Erasing;                                                        // блок, стирание которого запущено (FLASH_FTL_NONE - нет)
+    uint32_t    Seq;                                                            // порядковый номер последней выдачи блока
+    uint16_t    Map[_FLASH_FTL_BLOCKS];                                         // логический блок -> физический блок
+    uint8_t     State[_FLASH_FTL_BLOCKS];                                       // состояние физического блока (FLASH_FtlState_t)
+    uint32_t    Erases[_FLASH_FTL_BLOCKS];                                      // счётчик стираний физического блока
+#if (_FLASH_USE_FREERTOS == 1)
+    SemaphoreHandle_t Mutex;                                                    // мьютекс таблиц
+    TaskHandle_t Task;                                                          // фоновая задача стирания устаревших блоков
+#endif
+} FLASH_Ftl_t;
+
+static FLASH_Ftl_t          flashFtl[_FLASH_FTL_DEVICES];                       // таблицы FTL устройств
+
+static void Flash_FtlLock   (FLASH_Ftl_t *ftl)                                  // функция захвата таблиц FTL задачей
+{
+#if (_FLASH_USE_FREERTOS == 1)
+    xSemaphoreTake          (ftl->Mutex, portMAX_DELAY);
+#else
+    (void)ftl;
+#endif
+}
+
+static void Flash_FtlUnlock (FLASH_Ftl_t *ftl)                                  // функция освобождения таблиц FTL
+{
+#if (_FLASH_USE_FREERTOS == 1)
+    xSemaphoreGive          (ftl->Mutex);
+#else
+    (void)ftl;
+#endif
+}
+
+static uint32_t Flash_FtlCheck (const FLASH_FtlSlot_t *s)                       // функция расчёта контрольного слова слота
+{
+    return ~(s->Magic ^ s->Value ^ s->Seq);
+}
+
+static void Flash_FtlReadSlots (FLASH_Ftl_t *ftl, uint16_t phys, FLASH_FtlSlot_t *s)  // функция чтения обоих слотов заголовка физического блока
+{
+    Flash_ReadPage          (ftl->Dev, (phys + 1u) * ftl->PagesPerBlock - 1, 0, 2 * sizeof (*s), (uint8_t*)s);
+}
+
+static void Flash_FtlWriteSlot (FLASH_Ftl_t *ftl, uint16_t phys, uint8_t slot,  // функция записи слота заголовка (NOR допускает повторное программирование страницы по стёртым байтам)
+                                uint32_t magic, uint32_t value, uint32_t seq)
+{
+    FLASH_FtlSlot_t s       = { magic, value, seq, 0 };
+    s.Check                 = Flash_FtlCheck (&s);
+    Flash_WritePage         (ftl->Dev, (phys + 1u) * ftl->PagesPerBlock - 1, slot * sizeof (s), sizeof (s), (uint8_t*)&s);
+}
+
+static bool Flash_FtlSlotIs (const FLASH_FtlSlot_t *s, uint32_t magic)          // функция проверки слота: magic = 0xFFFFFFFF -> слот не записан
+{
+    if (magic == 0xFFFFFFFF)
+        return s->Magic == magic && s->Value == magic && s->Seq == magic && s->Check == magic;
+    return s->Magic == magic && s->Check == Flash_FtlCheck (s);
+}
+
+static bool Flash_FtlBlank  (FLASH_Ftl_t *ftl, uint16_t phys)                   // функция проверки физического блока на стёртость (чтение много быстрее стирания)
+{                                                                               // блок читается одной командой под одним захватом м/сх, до первого отличия
+    FLASH_t  *dev           = ftl->Dev;
+    if (dev->Stripe[0])                                                         // виртуальное устройство: блок лежит на двух м/сх -> проверка не выполняется, блок стирается
+        return false;
+    Flash_Lock              (dev);                                              // захват м/сх памяти
+    Flash_Resume            (dev);                                              // ожидание завершения операции и пробуждение м/сх
+    bool      blank         = Flash_ReadCompare (dev, Flash_PageAddr (dev, (uint32_t)phys * ftl->PagesPerBlock, 0), NULL, dev->ErasableSize);
+    Flash_Unlock            (dev);                                              // освобождение м/сх памяти
+    return blank;
+}
+
+static bool Flash_FtlStep   (FLASH_Ftl_t *ftl, bool wait)                       // функция одного шага пополнения запаса: завершение стирания, проверка или стирание блока
+{                                                                               // wait = false (фоновая задача) -> занятую м/сх не ждёт; результат: true - работа ещё есть
+    FLASH_t  *dev           = ftl->Dev;
+    uint16_t  p             = ftl->Erasing;
+    if (p != FLASH_FTL_NONE)                                                    // стирание запущено ->
+    {
+        if (!wait && !Flash_IsIdle (dev))                                       // ещё идёт: фон не ждёт
+            return true;
+        ftl->Erasing        = FLASH_FTL_NONE;
+        ftl->Erases[p]++;
+        Flash_FtlWriteSlot  (ftl, p, 0, FLASH_FTL_ERASED, ftl->Erases[p], 0xFFFFFFFF);  // счётчик стираний сохраняется на м/сх
+        ftl->State[p]       = FLASH_FTL_FREE;
+        return true;
+    }
+    for (uint16_t i = 0; i < ftl->Blocks; i++)                                  // поиск устаревшего блока, затем - блока с пустым заголовком
+        if (ftl->State[i] == FLASH_FTL_STALE || (ftl->State[i] == FLASH_FTL_UNKNOWN && p == FLASH_FTL_NONE))
+        {
+            p               = i;
+            if (ftl->State[i] == FLASH_FTL_STALE)
+                break;
+        }
+    if (p == FLASH_FTL_NONE)                                                    // запас полон
+        return false;
+    if (!wait && !Flash_IsIdle (dev))                                           // м/сх занята операцией задачи-писателя
+        return true;
+    if (ftl->State[p] == FLASH_FTL_UNKNOWN && Flash_FtlBlank (ftl, p))          // новая м/сх: блок уже стёрт -> только заголовок
+    {
+        Flash_FtlWriteSlot  (ftl, p, 0, FLASH_FTL_ERASED, ftl->Erases[p], 0xFFFFFFFF);
+        ftl->State[p]       = FLASH_FTL_FREE;
+        return true;
+    }
+    if (!Flash_EraseRange (dev, (uint32_t)p * dev->ErasableSize, dev->ErasableSize))  // команда стирания не прошла -> блок не стёрт и в запас не попадает
+    {
+        ftl->State[p]       = FLASH_FTL_STALE;                                  // стирание повторит следующий шаг
+        return false;                                                           // (FtlAlloc не повторяет его бесконечно)
+    }
+    ftl->State[p]           = FLASH_FTL_ERASING;                                // завершения не ждём: его проверит следующий шаг,
+    ftl->Erasing            = p;                                                // он же увеличит счётчик стираний
+    return true;
+}
+
+static uint16_t Flash_FtlAlloc (FLASH_Ftl_t *ftl)                               // функция выбора наименее изношенного стёртого блока из запаса
+{                                                                               // запас пуст -> блок стирается на месте (фоновая задача не успела)
+    for (;;)
+    {
+        uint16_t  best      = FLASH_FTL_NONE;
+        for (uint16_t i = 0; i < ftl->Blocks; i++)
+            if (ftl->State[i] == FLASH_FTL_FREE && (best == FLASH_FTL_NONE || ftl->Erases[i] < ftl->Erases[best]))
+                best        = i;
+        if (best != FLASH_FTL_NONE || !Flash_FtlStep (ftl, true))
+            return best;
+    }
+}
+
+static uint16_t Flash_FtlMap (FLASH_Ftl_t *ftl, uint32_t block)                 // функция получения физического блока логического блока
+{
+    uint16_t                phys = FLASH_FTL_NONE;
+    Flash_FtlLock           (ftl);
+    if (block < ftl->Logical)
+        phys                = ftl->Map[block];
+    Flash_FtlUnlock         (ftl);
+    return phys;
+}
+
+static uint16_t Flash_FtlErase (FLASH_Ftl_t *ftl, uint32_t block)               // функция "стирания" логического блока: замена физического блока стёртым из запаса
+{
+    uint16_t                phys = FLASH_FTL_NONE;
+    if (block >= ftl->Logical)
+        return phys;
+    Flash_FtlLock           (ftl);
+    phys                    = Flash_FtlAlloc (ftl);
+    if (phys != FLASH_FTL_NONE)
+    {
+        uint16_t  old       = ftl->Map[block];
+        Flash_FtlWriteSlot  (ftl, phys, 1, FLASH_FTL_MAPPED, block, ++ftl->Seq);  // после записи слота новый блок действует и после сброса
+        ftl->State[phys]    = FLASH_FTL_USED;
+        ftl->Map[block]     = phys;
+        if (old != FLASH_FTL_NONE)                                              // прежний блок - в очередь на стирание
+        {
+            Flash_CacheInvalidate (ftl->Dev, (uint32_t)old * ftl->PagesPerBlock, ftl->PagesPerBlock);
+            ftl->State[old] = FLASH_FTL_STALE;
+        }
+    }
+    Flash_FtlUnlock         (ftl);
+#if (_FLASH_USE_FREERTOS == 1)
+    if (ftl->Task != NULL)
+        xTaskNotifyGive     (ftl->Task);                                        // пополнение запаса
+#endif
+    return phys;
+}
+
+static bool Flash_FtlLocate (FLASH_Ftl_t *ftl, uint32_t block, uint32_t off,    // функция перевода адреса LittleFS (блок + смещение) в физическую страницу
+                                               bool prog, uint32_t *page)
+{                                                                               // неотображённый блок: prog = true -> выдаётся стёртый, иначе - читается как стёртый
+    uint16_t  phys          = Flash_FtlMap (ftl, block);
+    if (phys == FLASH_FTL_NONE && prog)
+        phys                = Flash_FtlErase (ftl, block);
+    *page                   = (uint32_t)phys * ftl->PagesPerBlock + off / ftl->Dev->PgSize;
+    return phys != FLASH_FTL_NONE;
+}
+
+#if (_FLASH_USE_FREERTOS == 1)
+static void Flash_FtlThread (void *arg)                                         // фоновая задача FTL: стирание устаревших блоков, пока м/сх свободна
+{
+    FLASH_Ftl_t *ftl        = (FLASH_Ftl_t*)arg;
+    for (;;)
+        if (Flash_FtlTask (ftl->Dev))                                           // работа есть: следующий шаг - после паузы, м/сх отдана задачам-писателям
+            vTaskDelay      (pdMS_TO_TICKS (_FLASH_FTL_POLL_MS));
+        else
+            ulTaskNotifyTake (pdTRUE, portMAX_DELAY);                           // запас полон: ожидание выдачи блока
+}
+#endif
+#endif
+
+bool Flash_FtlInit          (FLASH_t *dev)                                      // функция подключения FTL к опознанной м/сх: восстановление таблицы отображения по заголовкам блоков
+{                                                                               // вызывается после Flash_Init; AT45DBXXX стирает страницу при программировании -> FTL не нужен
+#if (_FLASH_USE_FTL == 1)
+    FLASH_Ftl_t *ftl        = NULL;
+    for (uint8_t i = 0; i < _FLASH_FTL_DEVICES && !ftl; i++)
+        if (flashFtl[i].Dev == dev || flashFtl[i].Dev == NULL)
+            ftl             = &flashFtl[i];
+    if (!ftl || !dev->PgSize || dev->ErasableSize < 2 * dev->PgSize || FLASH_IS_AT45 (dev))
+        return false;
+    if (dev->NumOfErasable > _FLASH_FTL_BLOCKS || dev->NumOfErasable <= _FLASH_FTL_SPARE)  // таблицы не вмещают все блоки м/сх (блоки вне FTL не были бы видны LittleFS) или запаса не остаётся
+        return false;
+    uint16_t  blocks        = (uint16_t)dev->NumOfErasable;
+#if (_FLASH_USE_FREERTOS == 1)
+    if (ftl->Mutex == NULL)                                                     // мьютекс таблиц - до запуска фоновой задачи и до первого захвата
+        ftl->Mutex          = xSemaphoreCreateMutex ();
+    if (ftl->Mutex == NULL)
+        return false;
+#endif
+    Flash_FtlLock           (ftl);
+    ftl->Dev                = dev;
+    ftl->Blocks             = blocks;
+    ftl->Logical            = blocks - _FLASH_FTL_SPARE;                        // запас: блоки, которые стираются заранее
+    ftl->PagesPerBlock      = dev->ErasableSize / FLASH_PGSIZE (dev);
+    ftl->Erasing            = FLASH_FTL_NONE;
+    ftl->Seq                = 0;
+    uint32_t  maxErases     = 0;
+    for (uint16_t l = 0; l < ftl->Logical; l++)
+        ftl->Map[l]         = FLASH_FTL_NONE;
+    for (uint16_t p = 0; p < blocks; p++)                                       // чтение заголовков: по 32 байта на блок
+    {
+        FLASH_FtlSlot_t s[2];
+        Flash_FtlReadSlots  (ftl, p, s);
+        ftl->State[p]       = FLASH_FTL_STALE;                                  // повреждённый заголовок (прерванное стирание или запись) -> блок стирается
+        ftl->Erases[p]      = 0;
+        if (Flash_FtlSlotIs (&s[0], 0xFFFFFFFF))                                // заголовок пуст: блок новой м/сх или стирание прервано
+            ftl->State[p]   = FLASH_FTL_UNKNOWN;
+        else if (Flash_FtlSlotIs (&s[0], FLASH_FTL_ERASED))
+        {
+            ftl->Erases[p]  = s[0].Value;
+            maxErases       = s[0].Value > maxErases ? s[0].Value : maxErases;
+            if (Flash_FtlSlotIs (&s[1], 0xFFFFFFFF))                            // блок стёрт и не выдан
+                ftl->State[p] = FLASH_FTL_FREE;
+            else if (Flash_FtlSlotIs (&s[1], FLASH_FTL_MAPPED) && s[1].Value < ftl->Logical)
+            {
+                uint16_t  l = s[1].Value, q = ftl->Map[l];
+                FLASH_FtlSlot_t t[2];
+                if (q != FLASH_FTL_NONE)                                        // у логического блока два физических: прежний не успели стереть
+                    Flash_FtlReadSlots (ftl, q, t);
+                if (q == FLASH_FTL_NONE || s[1].Seq > t[1].Seq)                 // действует поздний
+                {
+                    if (q != FLASH_FTL_NONE)
+                        ftl->State[q] = FLASH_FTL_STALE;
+                    ftl->Map[l] = p;
+                    ftl->State[p] = FLASH_FTL_USED;
+                }
+                ftl->Seq    = s[1].Seq > ftl->Seq ? s[1].Seq : ftl->Seq;
+            }
+        }
+    }
+    for (uint16_t p = 0; p < blocks; p++)                                       // износ блока с пустым заголовком не известен -> считается наибольшим из известных
+        if (ftl->State[p] == FLASH_FTL_UNKNOWN)
+            ftl->Erases[p]  = maxErases;
+    dev->Ftl                = ftl;
+    Flash_FtlUnlock         (ftl);
+#if (_FLASH_USE_FREERTOS == 1)
+    if (ftl->Task == NULL)
+        xTaskCreate         (Flash_FtlThread, "flashFtl", _FLASH_FTL_STACK, ftl, _FLASH_FTL_PRIORITY, &ftl->Task);
+    else
+        xTaskNotifyGive     (ftl->Task);
+#endif
+    return true;
+#else
+    (void)dev;
+    return false;
+#endif
+}
+
+bool Flash_FtlTask          (FLASH_t *dev)                                      // функция одного шага фонового стирания FTL (FreeRTOS - из задачи драйвера, без ОС - из главного цикла)
+{                                                                               // результат: true - устаревшие блоки ещё есть
+#if (_FLASH_USE_FTL == 1)
+    bool                    more = false;
+    if (dev->Ftl)
+    {
+        Flash_FtlLock       (dev->Ftl);
+        more                = Flash_FtlStep (dev->Ftl, false);
+        Flash_FtlUnlock     (dev->Ftl);
+    }
+    return more;
+#else
+    (void)dev;
+    return false;
+#endif
+}
+
+// ------------------------------- Функции-прокладки для связки LittleFS и SPI_Flash: -----------------------------------------------------
+
+void Flash_LfsConfig        (FLASH_t *dev, struct lfs_config *cfg)              // функция заполнения конфигурации LittleFS по опознанной м/сх: функции-прокладки, геометрия, размеры буферов
+{                                                                               // AT45DBXXX в режиме страниц 2^n (_FLASH_AT45_BINARY) даёт размеры-степени двойки
+    cfg->context            = dev;                                              // функции-прокладки работают с устройством из контекста
+    cfg->read               = block_device_read;
+    cfg->prog               = block_device_prog;
+    cfg->erase              = block_device_erase;
+    cfg->sync               = block_device_sync;
+    cfg->block_size         = dev->ErasableSize;                                // минимальная стираемая область
+    cfg->block_count        = dev->NumOfErasable;
+#if (_FLASH_USE_FTL == 1)
+    if (dev->Ftl)                                                               // FTL: последняя страница физического блока - заголовок, часть блоков - запас
+    {
+        cfg->block_size     = dev->ErasableSize - FLASH_PGSIZE (dev);
+        cfg->block_count    = dev->Ftl->Logical;
+    }
+#endif
+    cfg->read_size          = FLASH_IS_NOR (dev) ? 16 : FLASH_PGSIZE (dev);     // NOR: мелкие чтения и программирования части страницы (кэш драйвера объединяет их),
+    cfg->prog_size          = cfg->read_size;                                   // AT45DBXXX: блок - одна страница
+    cfg->cache_size         = FLASH_PGSIZE (dev);                               // буфер LittleFS - страница: обмен с м/сх по границам страниц
+    cfg->lookahead_size     = (cfg->block_count + 63) / 64 * 8;                 // бит на каждый блок носителя (кратно 8 байтам), но не больше 128 байт
+    if (cfg->lookahead_size > 128)
+        cfg->lookahead_size = 128;
+}
+
+static FLASH_t *Flash_LfsDevice (const struct lfs_config *c)                    // функция получения устройства носителя LittleFS (контекст не задан -> устройство по умолчанию)
+{
+    return c->context ? (FLASH_t*)c->context : &flash;
+}
+
+static int Flash_LfsCheck   (FLASH_t *dev, lfs_block_t block, lfs_off_t off, lfs_size_t size)  // функция проверки обращения LittleFS (результат - код ошибки LittleFS)
+{
+    uint32_t  blockSize     = dev->ErasableSize;
+    uint32_t  blocks        = dev->NumOfErasable;
+#if (_FLASH_USE_FTL == 1)
+    if (dev->Ftl)
+    {
+        blockSize          -= FLASH_PGSIZE (dev);
+        blocks              = dev->Ftl->Logical;
+    }
+#endif
+    if (!dev->Id)                                                               // м/сх не опознана
+        return LFS_ERR_IO;
+    if (block >= blocks || off > blockSize || size > blockSize - off)           // обращение за пределы блока
+        return LFS_ERR_INVAL;
+    return LFS_ERR_OK;
+}
+
+int block_device_read       (const struct lfs_config *c, lfs_block_t block,     // функция-прокладка для чтения массива блока: блок и смещение -> страница м/сх,
+                                   lfs_off_t off, void *buffer, lfs_size_t size)
+{                                                                               // блок целиком читается одной командой
+    FLASH_t  *dev           = Flash_LfsDevice (c);
+    int                     err = Flash_LfsCheck (dev, block, off, size);
+    if (err)
+        return err;
+    uint32_t  page          = block * (dev->ErasableSize / FLASH_PGSIZE (dev)) + off / FLASH_PGSIZE (dev);
+#if (_FLASH_USE_FTL == 1)
+    if (dev->Ftl && !Flash_FtlLocate (dev->Ftl, block, off, false, &page))      // FTL: блок ни разу не стирался -> читается как стёртый
+    {
+        memset              (buffer, 0xFF, size);
+        return LFS_ERR_OK;
+    }
+#endif
+    return Flash_CacheRead (dev, page, off % FLASH_PGSIZE (dev), size, (uint8_t*)buffer) ? LFS_ERR_OK : LFS_ERR_IO;
+}
+
+int block_device_prog       (const struct lfs_config *c, lfs_block_t block,     // функция-прокладка для записи массива блока. блок должен быть заранее очищен.
+                             lfs_off_t off, const void *buffer, lfs_size_t size)
+{                                                                               // массив делится только по границам страниц м/сх
+    FLASH_t  *dev           = Flash_LfsDevice (c);
+    int                     err = Flash_LfsCheck (dev, block, off, size);
+    if (err)
+        return err;
+    uint32_t  page          = block * (dev->ErasableSize / FLASH_PGSIZE (dev)) + off / FLASH_PGSIZE (dev);
+#if (_FLASH_USE_FTL == 1)
+    if (dev->Ftl && !Flash_FtlLocate (dev->Ftl, block, off, true, &page))       // FTL: запас исчерпан и стереть нечего
+        return LFS_ERR_IO;
+#endif
+    return Flash_CacheProg (dev, page, off % FLASH_PGSIZE (dev), size, (const uint8_t*)buffer) ? LFS_ERR_OK : LFS_ERR_IO;
 }
 
 int block_device_erase      (const struct lfs_config *c, lfs_block_t block)     // функция-прокладка для удаления области, например, перед записью. состояние стертого блока не определено.
-{   
-    Flash_EraseArea         ((uint32_t)block);                                  // очистка указанной области
-	return 0;
+{
+    FLASH_t  *dev           = Flash_LfsDevice (c);
+    int                     err = Flash_LfsCheck (dev, block, 0, 0);
+    if (err)
+        return err;
+#if (_FLASH_USE_FTL == 1)
+    if (dev->Ftl)                                                               // FTL: вместо стирания - стёртый блок из запаса, без ожидания м/сх
+        return Flash_FtlErase (dev->Ftl, block) != FLASH_FTL_NONE ? LFS_ERR_OK : LFS_ERR_IO;
+#endif
+    return Flash_EraseRange (dev, block * dev->ErasableSize, dev->ErasableSize) ? LFS_ERR_OK : LFS_ERR_IO;  // очистка указанной области наиболее крупными командами стирания (строки кэша области удаляются)
 }
 
-int block_device_sync       (const struct lfs_config *c)                        // функция-прокладка для синхронизации состояния носителя. необходима только для носителей с кэшем (не наш случай).
+int block_device_sync       (const struct lfs_config *c)                        // функция-прокладка для синхронизации состояния носителя: запись изменённых страниц кэша
 {
-	return 0;
+    FLASH_t  *dev           = Flash_LfsDevice (c);
+    if (!dev->Id)
+        return LFS_ERR_IO;
+    return Flash_CacheSync (dev) ? LFS_ERR_OK : LFS_ERR_IO;                     // ошибка записи страницы -> LittleFS повторит синхронизацию или сообщит об ошибке
 }
 // ------------------------------------------------------------------------------------------------------------------------------------------
@@ -4,27 +4,243 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#include "spi.h"
 #include "lfs.h"
-#include "equipment.h"
 
-typedef struct
+typedef enum
 {
+    FLASH_FAMILY_NONE       = 0,                                                // м/сх не опознана
+    FLASH_FAMILY_AT45,                                                          // AT45DBXXX: SRAM-буферы, адрес страницы со сдвигом, без защёлки записи
+    FLASH_FAMILY_NOR,                                                           // W25QXXX, MX25LXXXX и м/сх, описанные через SFDP: линейный адрес, защёлка записи
+} FLASH_Family_t;
+
+typedef struct                                                                  // команда стирания области
+{
+    uint32_t    Pages;                                                          // размер стираемой области в страницах
+    uint8_t     Cmd;                                                            // код команды стирания
+    uint16_t    Ms;                                                             // типовое время стирания (мс)
+    uint16_t    MaxMs;                                                          // максимальное время стирания (мс)
+} FLASH_Erase_t;
+
+typedef struct                                                                  // описание м/сх: строка таблицы известных м/сх или результат разбора SFDP
+{
+    uint8_t     Mnf;                                                            // идентификатор производителя (JEDEC)
+    uint32_t    DevId;                                                          // байты 1-4 ответа на команду 0x9F
+    uint32_t    DevMask;                                                        // значимые биты DevId
+    uint8_t     Id;                                                             // внутренний номер-идентификатор м/сх
+    uint8_t     Family;                                                         // семейство м/сх (FLASH_Family_t)
+    uint16_t    PgSize;                                                         // размер страницы в байтах
+    uint32_t    Pages;                                                          // количество страниц
+    uint8_t     Shift;                                                          // число битов смещения внутри страницы в адресе команды
+    uint8_t     AddrLen;                                                        // количество байтов адреса в командах массива (3 или 4)
+    uint8_t     ReadCmd;                                                        // самая быстрая команда чтения массива по одной линии
+    uint8_t     ReadDummy;                                                      // количество фиктивных тактов команды чтения
+    uint8_t     ProgCmd;                                                        // команда программирования страницы
+    uint16_t    TppMs;                                                          // типовое время программирования страницы (мс)
+    uint16_t    TppMaxMs;                                                       // максимальное время программирования страницы (мс)
+    uint32_t    TceMs;                                                          // типовое время стирания чипа (мс)
+    uint32_t    TceMaxMs;                                                       // максимальное время стирания чипа (мс)
+    FLASH_Erase_t Erase[3];                                                     // команды стирания, от крупной к мелкой
+    uint8_t     SuspendCmd;                                                     // команда приостановки программирования/стирания (0 - не поддерживается)
+    uint8_t     ResumeCmd;                                                      // команда возобновления приостановленной операции
+    uint16_t    TsusUs;                                                         // наибольшее время приостановки (мкс); столько же м/сх работает после возобновления до следующей приостановки
+} FLASH_Desc_t;
+
+typedef struct FLASH_s                                                          // устройство: м/сх на своей шине или виртуальное устройство из двух м/сх с чередованием страниц
+{
+    void       *Bus;                                                            // дескриптор шины HAL: SPI_HandleTypeDef (QSPI_HandleTypeDef при _FLASH_USE_QSPI = 1)
+    void       *CsGpio;                                                         // порт (GPIO_TypeDef) и вывод Chip Select (низкий уровень - работа с м/сх)
+    uint16_t    CsPin;
+    void       *WpGpio;                                                         // порт (GPIO_TypeDef) и вывод Write Protect (низкий уровень - запись запрещена)
+    uint16_t    WpPin;
+    void       *RstGpio;                                                        // порт (GPIO_TypeDef) и вывод Reset (низкий уровень - сброс)
+    uint16_t    RstPin;
+    struct FLASH_s *BusOwner;                                                   // устройство, с которым м/сх делит шину: захватывается его мьютекс (NULL - шина своя; общей шине обязателен)
+    struct FLASH_Ftl_s *Ftl;                                                    // таблицы слоя трансляции блоков (NULL - LittleFS работает с блоками м/сх напрямую)
+    struct FLASH_Prefetch_s *Prefetch;                                          // кольцо упреждающего чтения (NULL - последовательные чтения не упреждаются)
+    struct FLASH_s *Inflight;                                                   // у владельца шины: м/сх, упреждающее чтение которой идёт по DMA (NULL - шина свободна)
+    struct FLASH_s *Stripe[2];                                                  // м/сх виртуального устройства: чётные страницы - на Stripe[0], нечётные - на Stripe[1] (NULL - м/сх одна)
+    void       *Mutex;                                                          // мьютекс доступа к м/сх (FreeRTOS: SemaphoreHandle_t, создаётся в Flash_Init)
+    void       *DmaDone;                                                        // семафор завершения DMA-передачи (FreeRTOS: SemaphoreHandle_t)
+    volatile bool DmaWait;                                                      // устройство ждёт завершения DMA-передачи на своей шине
+    volatile bool DmaFlag;                                                      // флаг завершения DMA-передачи (без ОС)
+    volatile uint8_t DmaStatus;                                                 // результат завершённой DMA-передачи (HAL_StatusTypeDef)
     uint16_t    PgSize;                                                         // размер одной страницы памяти в байтах
     uint32_t    Pages;                                                          // общее количество страниц памяти на м/сх
-    uint16_t    ErasableSize;                                                   // минимальный размер стираемого блока (только для LittleFS)
-    uint16_t    NumOfErasable;                                                  // общее количество стираемых блоков   (только для LittleFS)
-    uint8_t	    Shift;                                                          // число фиктивных битов сдвига для вычисления абсолютного адреса
-    uint8_t     Id;                                                             // внутренний уникальный номер-идентификатор м/сх (1-63: для AT45DBXXX; 64-255: для W25QXX)
-    bool        Busy;                                                           // флаг занятости м/сх памяти: true = м/сх выполняет команду, false = м/сх готова для выполнения команды
+    uint32_t    ErasableSize;                                                   // минимальный размер стираемого блока (только для LittleFS)
+    uint32_t    NumOfErasable;                                                  // общее количество стираемых блоков   (только для LittleFS)
+    uint8_t	    Shift;                                                          // число битов смещения внутри страницы в адресе команды: адрес = (страница << Shift) + смещение
+    uint8_t     Mnf;                                                            // идентификатор производителя м/сх (JEDEC)
+    uint8_t     Lines;                                                          // количество линий данных при чтении массива: 1, 2 (Dual Output) или 4 (Quad I/O)
+    uint8_t     AddrLen;                                                        // количество байтов адреса в командах массива: 3 или 4 (м/сх объёмом больше 16 Мб)
+    uint8_t     Id;                                                             // внутренний уникальный номер-идентификатор м/сх (0 - м/сх не опознана, FLASH_ID_SFDP - описана через SFDP)
+    uint8_t     Family;                                                         // семейство м/сх (FLASH_Family_t)
+    bool        Linear;                                                         // адрес в командах м/сх совпадает с линейным адресом (страница 2^Shift байт)
+    FLASH_Desc_t Desc;                                                          // описание опознанной м/сх: команды и времена операций
+    volatile bool Busy;                                                         // флаг занятости м/сх памяти: true = м/сх выполняет команду, false = м/сх готова для выполнения команды
+    uint8_t     Pending;                                                        // внутренняя операция м/сх, завершения которой ещё не дождались (FLASH_Op_t)
+    uint32_t    PendingUntil;                                                   // ожидаемый момент завершения внутренней операции (тики HAL_GetTick)
+    bool        Asleep;                                                         // м/сх усыплена командой 0xB9 и перед обращением должна быть разбужена командой 0xAB
+    uint32_t    LastAccess;                                                     // момент последнего обращения к м/сх (для усыпления по простою)
+    uint32_t    PendingDeadline;                                                // момент, после которого операция считается зависшей (максимальное время по описанию м/сх)
+    uint32_t    PendingTimeouts;                                                // количество операций, не завершившихся за максимальное время
+    uint32_t    PendingPage;                                                    // первая страница, занятая внутренней операцией
+    uint32_t    PendingPages;                                                   // количество занятых страниц (0 - операцию нельзя приостановить: стирание чипа, запись регистра)
+    bool        Suspended;                                                      // внутренняя операция приостановлена ради чтения
+    uint32_t    SuspendedAt;                                                    // момент приостановки (тики): срок операции продлевается на время приостановки
+    uint32_t    Suspends;                                                       // количество приостановок программирования/стирания
+    uint8_t     PendingSuspends;                                                // приостановки текущей операции (не больше _FLASH_SUSPEND_MAX)
+    uint32_t    BusyPolls;                                                      // количество опросов регистра состояния при ожидании готовности м/сх
+    uint32_t    BusySleep;                                                      // суммарное время сна при ожидании готовности м/сх (мс) = процессорное время, отданное другим задачам
+    bool        WriteAvoid;                                                     // режим исключения лишних записей: страницы с совпадающими данными не программируются, стёртые области не стираются
+    uint32_t    SkippedWrites;                                                  // количество пропущенных программирований страниц
+    uint32_t    SkippedErases;                                                  // количество пропущенных стираний
 } FLASH_t;
 
+#define FLASH_DEVICE(bus, csGpio, csPin, wpGpio, wpPin, rstGpio, rstPin)        /* описание устройства на своей шине: FLASH_t flash2 = FLASH_DEVICE (&hspi2, ...) */ \
+    { .Bus = (bus), .CsGpio = (csGpio), .CsPin = (csPin), .WpGpio = (wpGpio), .WpPin = (wpPin), .RstGpio = (rstGpio), .RstPin = (rstPin) }
+#define FLASH_STRIPE(dev0, dev1)                                                /* виртуальное устройство из двух м/сх: FLASH_t raid = FLASH_STRIPE (&flash, &flash2) */ \
+    { .Stripe = { (dev0), (dev1) } }
+
+extern FLASH_t flash;                                                           // устройство по умолчанию: шина и выводы из настроек _FLASH_SPI/_FLASH_QSPI
+
+typedef enum
+{
+    FLASH_OP_NONE           = 0,                                                // м/сх свободна
+    FLASH_OP_PROGRAM,                                                           // идёт программирование страницы
+    FLASH_OP_ERASE,                                                             // идёт стирание области
+    FLASH_OP_CHIPERASE,                                                         // идёт стирание чипа
+} FLASH_Op_t;
+
+typedef enum
+{
+    FLASH_DIR_NONE          = 0,                                                // транзакция без фазы данных (одиночная команда)
+    FLASH_DIR_TX,                                                               // фаза данных: запись в м/сх
+    FLASH_DIR_RX,                                                               // фаза данных: чтение из м/сх
+} FLASH_Dir_t;
+
+typedef struct                                                                  // описание транзакции: всё, что передаётся в пределах одного Chip Select
+{
+    uint8_t     Cmd;                                                            // код команды
+    uint8_t     AddrLen;                                                        // количество байтов адреса (0, 3 или 4)
+    uint8_t     AddrLines;                                                      // количество линий для адреса и байта режима (0/1, 2, 4; больше одной - только QUADSPI)
+    uint8_t     ModeLen;                                                        // количество байтов режима после адреса (0 или 1)
+    uint8_t     Mode;                                                           // байт режима (M7-M0)
+    uint8_t     DummyCycles;                                                    // количество фиктивных тактов после адреса (обычный SPI: кратно 8)
+    uint8_t     DataLines;                                                      // количество линий для фазы данных (0/1, 2, 4; больше одной - только QUADSPI)
+    uint8_t     Dir;                                                            // направление фазы данных (FLASH_Dir_t)
+    uint32_t    Addr;                                                           // адрес в формате команды м/сх
+    uint8_t    *Buf;                                                            // буфер фазы данных
+    uint32_t    Len;                                                            // длина фазы данных в байтах
+    bool        Hold;                                                           // не снимать Chip Select по окончании: фазу данных продолжает вызывающая функция
+} FLASH_Xfer_t;
+
+typedef struct                                                                  // сегмент массива для Flash_ReadV/Flash_WriteV: массив собирается из нескольких буферов
+{
+    uint8_t    *Buf;                                                            // буфер сегмента
+    uint32_t    Len;                                                            // длина сегмента в байтах
+} FLASH_Seg_t;
+
+typedef enum
+{
+    FLASH_REQ_READ          = 0,                                                // чтение массива (Flash_Read)
+    FLASH_REQ_WRITE,                                                            // запись массива (Flash_Write)
+    FLASH_REQ_ERASE,                                                            // стирание диапазона (Flash_EraseRange)
+} FLASH_ReqOp_t;
+
+typedef struct FLASH_Req_s                                                      // запрос к планировщику: память запроса и буфера принадлежат драйверу до Done
+{
+    FLASH_t    *Dev;                                                            // м/сх (устройство)
+    uint8_t     Op;                                                             // операция (FLASH_ReqOp_t)
+    uint32_t    Addr;                                                           // линейный адрес
+    uint32_t    Len;                                                            // длина в байтах
+    uint8_t    *Buf;                                                            // буфер данных (для стирания не нужен)
+    void       *Notify;                                                         // задача, которой приходит уведомление о завершении (FreeRTOS: TaskHandle_t, индекс _FLASH_NOTIFY_INDEX; NULL - без уведомления)
+    volatile bool Done;                                                         // запрос выполнен
+    bool        Ok;                                                             // результат выполнения
+    uint32_t    Queued;                                                         // момент постановки в очередь (заполняет планировщик)
+    struct FLASH_Req_s *Next;                                                   // следующий запрос очереди (заполняет планировщик)
+} FLASH_Req_t;
+
+typedef struct                                                                  // статистика планировщика запросов
+{
+    uint32_t    Submitted;                                                      // поставлено запросов
+    uint32_t    Completed;                                                      // завершено запросов
+    uint32_t    Commands;                                                       // выполнено команд: объединённые запросы - одна команда
+    uint32_t    MergedReads;                                                    // чтения, присоединённые к другому чтению
+    uint32_t    MergedWrites;                                                   // записи, присоединённые к другой записи
+    uint32_t    Depth;                                                          // текущая глубина очереди
+    uint32_t    MaxDepth;                                                       // наибольшая глубина очереди
+    uint32_t    WaitSumMs;                                                      // суммарное ожидание запросов в очереди (мс)
+    uint32_t    WaitMaxMs;                                                      // наибольшее ожидание запроса в очереди (мс)
+} FLASH_SchedStats_t;
+
+extern FLASH_SchedStats_t flashSchedStats;
+
+typedef struct                                                                  // статистика кэша страниц функций-прокладок LittleFS
+{
+    uint32_t    Hits;                                                           // обращения, обслуженные без обмена с м/сх
+    uint32_t    Misses;                                                         // обращения, потребовавшие загрузки страницы
+    uint32_t    Evictions;                                                      // вытеснения занятых строк
+    uint32_t    WriteBacks;                                                     // записи изменённых страниц на м/сх
+    uint32_t    Bypassed;                                                       // целые страницы, прочитанные или записанные мимо кэша
+    uint32_t    Syncs;                                                          // вызовы синхронизации
+} FLASH_CacheStats_t;
+
+extern FLASH_CacheStats_t flashCacheStats;
+
+typedef struct                                                                  // статистика упреждающего чтения
+{
+    uint32_t    Loads;                                                          // запущенные приёмы следующих страниц
+    uint32_t    Hits;                                                           // чтения, обслуженные из кольца без обмена с м/сх
+    uint32_t    Misses;                                                         // чтения м/сх с кольцом, потребовавшие обмена с м/сх
+    uint32_t    Wasted;                                                         // принятые страницы, вытесненные или сброшенные непрочитанными
+    uint32_t    Invalidations;                                                  // половины кольца, сброшенные записью или стиранием
+} FLASH_PrefetchStats_t;
+
+extern FLASH_PrefetchStats_t flashPrefetchStats;
+
+typedef enum                                                                    // операции, учитываемые в статистике (при _FLASH_USE_STATS = 1)
+{
+    FLASH_STAT_READ         = 0,                                                // чтение массива (Flash_ReadPage, Flash_Read)
+    FLASH_STAT_PROGRAM,                                                         // программирование (Flash_WritePage, Flash_WritePages, Flash_UpdatePage)
+    FLASH_STAT_ERASE,                                                           // стирание диапазона (Flash_EraseRange, Flash_EraseArea)
+    FLASH_STAT_CHIPERASE,                                                       // стирание чипа (запуск)
+    FLASH_STAT_WAIT,                                                            // ожидание завершения программирования/стирания
+    FLASH_STAT_RESUME,                                                          // пробуждение м/сх (Flash_Resume)
+    FLASH_STAT_SUSPEND,                                                         // приостановка программирования/стирания перед чтением
+    FLASH_STAT_OPS                                                              // количество учитываемых операций
+} FLASH_StatOp_t;
+
+#define FLASH_STAT_BUCKETS      16                                              // корзины гистограммы задержек: [2^i, 2^(i+1)) мкс, последняя - от 32 мс
+#define FLASH_STATS_VERSION     2                                               // версия формата двоичного снимка Flash_StatsSnapshot
+
+typedef struct                                                                  // статистика одной операции
+{
+    uint32_t    Count;                                                          // количество вызовов
+    uint32_t    Bytes;                                                          // количество переданных/обработанных байтов
+    uint64_t    TotalUs;                                                        // суммарная задержка (мкс)
+    uint32_t    MaxUs;                                                          // наибольшая задержка (мкс)
+    uint32_t    Hist[FLASH_STAT_BUCKETS];                                       // гистограмма задержек по степеням двойки
+} FLASH_OpStats_t;
+
+typedef struct                                                                  // статистика драйвера
+{
+    FLASH_OpStats_t Op[FLASH_STAT_OPS];                                         // по операциям (FLASH_StatOp_t)
+    uint32_t    BusyPolls;                                                      // чтения регистра состояния для проверки занятости
+    uint32_t    Wakeups;                                                        // отправленные команды пробуждения 0xAB
+    uint32_t    HalErrors;                                                      // вызовы HAL, вернувшие ошибку
+    uint32_t    HalTimeouts;                                                    // вызовы HAL, вернувшие таймаут
+} FLASH_Stats_t;
+
 // -------------- общие определения для для м/сх FLASH-памяти серий AT45DBXX и W25QXXX --------------------
 #define FLASH_GET_JEDEC_ID      0x9F                                            // чтение идентификатора устройства. MF(7:0), ID(15:8), ID(7:0)
 #define FLASH_PWRDOWN           0xB9                                            // режим сна с последующим снижением потребления энергии
 #define FLASH_RESUME            0xAB                                            // возобновление работы после сна
 #define FLASH_CHIP_ERASE        0xC7                                            // стирание чипа
 #define DUMMY_BYTE              0xA5                                            // прикольное число-палиндром
+#define FLASH_READ_SFDP         0x5A                                            // чтение таблиц SFDP.                          A[23:16], A[15:8], A[7:0], DUMMY, D7-D0
+#define FLASH_SFDP_SIGNATURE    0x50444653                                      // сигнатура заголовка SFDP: "SFDP"
+#define FLASH_ID_SFDP           255                                             // внутренний номер м/сх, не найденной в таблице и описанной через SFDP
 
 
 // -------------- определения для м/сх FLASH-памяти серии AT45DBXX --------------------
@@ -92,6 +308,13 @@ typedef struct
 #define AT45_AUTOWRBF1          0x58                                            // автоматическая перезапись страницы через буфер 1
 #define AT45_AUTOWRBF2          0x59                                            // автоматическая перезапись страницы через буфер 2
 #define AT45_RDSR               0xD7                                            // чтение регистра состояния
+#define AT45_PGSIZE1            0x3D                                            // выбор размера страницы - байт 1
+#define AT45_PGSIZE2            0x2A                                            // выбор размера страницы - байт 2
+#define AT45_PGSIZE3            0x80                                            // выбор размера страницы - байт 3
+#define AT45_PGSIZE4_BIN        0xA6                                            // выбор размера страницы - байт 4: страница 2^n байт ("binary")
+#define AT45_PGSIZE4_DF         0xA7                                            // выбор размера страницы - байт 4: страница 2^n + 2^(n-5) байт ("DataFlash")
+#define AT45_SUSPEND            0xB0                                            // приостановка программирования/стирания (серия E)
+#define AT45_RESUME             0xD0                                            // возобновление приостановленного программирования/стирания (серия E)
 
 // идентификаторы, маски
 #define AT45_ADESTO             0x1F                                            // идентификатор производителя: Atmel
@@ -102,11 +325,28 @@ typedef struct
 #define AT45_DEVID2_VERMSK      0x1F                                            // биты 0-4: MLC mask 
 #define AT45_DEVID2_MLCMSK      0xE0                                            // биты 5-7: MLC mask 
 
+// типовые и максимальные времена внутренних операций (мс)
+#define AT45_TEP_MS             15                                              // стирание + программирование страницы
+#define AT45_TEP_MAX_MS         35
+#define AT45_TPE_MS             10                                              // стирание страницы
+#define AT45_TPE_MAX_MS         35
+#define AT45_TBE_MS             45                                              // стирание блока (8 страниц)
+#define AT45_TBE_MAX_MS         100
+#define AT45_TSE_MS             1600                                            // стирание сектора
+#define AT45_TSE_MAX_MS         5000
+#define AT45_TCE_MSMB           8000                                            // стирание чипа, на каждый мегабайт объёма
+#define AT45_TCE_MAX_MSMB       22000
+#define AT45_TXFR_MAX_MS        1                                               // передача страницы в буфер, сравнение страницы с буфером (до 400 мкс)
+
+#define AT45_TRDPD_US           35                                              // выход из глубокого сна (мкс)
+#define AT45_TSUS_US            60                                              // приостановка программирования/стирания (мкс, с запасом)
+
 // определения битов регистра состояния
 #define AT45_SR_RDY             (1 << 7)                                        // бит 7: RDY/ Not BUSY 
 #define AT45_SR_COMP            (1 << 6)                                        // бит 6: COMP 
 #define AT45_SR_PROTECT         (1 << 1)                                        // бит 1: PROTECT 
 #define AT45_SR_PGSIZE          (1 << 0)                                        // бит 0: PAGE_SIZE 
+#define AT45_SR2_SUSPEND        0x07                                            // байт 2, биты 0-2: ES, PS1, PS2 - стирание/программирование из буфера 1/2 приостановлено
 
 // -------------- определения для м/сх FLASH-памяти серии W25QXXX --------------------
 // определения команд для м/сх серии w25qXXX
@@ -116,9 +356,21 @@ typedef struct
 #define W25_WREN                0x06                                            // разрешение записи в м/сх памяти
 #define W25_CE                  0xC7                                            // очистка чипа (альтернативная команда: 0x60)
 #define W25_SE                  0x20                                            // очистка указанного сектора.                  A[23:16], A[15:8], A[7:0]
+#define W25_BE32                0x52                                            // очистка указанного 32Кб блока.               A[23:16], A[15:8], A[7:0]
 #define W25_BE                  0xD8                                            // очистка указанного 64Кб блока.               A[23:16], A[15:8], A[7:0]
 #define W25_FAST_READ           0x0B                                            // быстрое чтение данных.                       A[23:16], A[15:8], A[7:0], DUMMY, D7-D0
+#define W25_FAST_READ_DUAL      0x3B                                            // быстрое чтение Dual Output.                  A[23:16], A[15:8], A[7:0], DUMMY, данные по 2 линиям
+#define W25_FAST_READ_QUAD      0x6B                                            // быстрое чтение Quad Output.                  A[23:16], A[15:8], A[7:0], DUMMY, данные по 4 линиям
+#define W25_FAST_READ_QUAD_IO   0xEB                                            // быстрое чтение Quad I/O.                     адрес, M7-M0, 4 такта DUMMY и данные - по 4 линиям
 #define W25_PP                  0x02                                            // программирование заданной страницы памяти.   A[23:16], A[15:8], A[7:0], D7-D0, D7-D0
+#define W25_FAST_READ4          0x0C                                            // быстрое чтение данных, 4-байтный адрес.      A[31:24], A[23:16], A[15:8], A[7:0], DUMMY, D7-D0
+#define W25_FAST_READ_DUAL4     0x3C                                            // быстрое чтение Dual Output, 4-байтный адрес. A[31:24], A[23:16], A[15:8], A[7:0], DUMMY, данные по 2 линиям
+#define W25_FAST_READ_QUAD_IO4  0xEC                                            // быстрое чтение Quad I/O, 4-байтный адрес.    адрес, M7-M0, 4 такта DUMMY и данные - по 4 линиям
+#define W25_PP4                 0x12                                            // программирование страницы, 4-байтный адрес.  A[31:24], A[23:16], A[15:8], A[7:0], D7-D0, D7-D0
+#define W25_SE4                 0x21                                            // очистка сектора, 4-байтный адрес.            A[31:24], A[23:16], A[15:8], A[7:0]
+#define W25_BE4                 0xDC                                            // очистка 64Кб блока, 4-байтный адрес.         A[31:24], A[23:16], A[15:8], A[7:0]
+#define W25_SUSPEND             0x75                                            // приостановка программирования/стирания
+#define W25_RESUME              0x7A                                            // возобновление приостановленного программирования/стирания
 #define W25_RDSR1               0x05                                            // чтение регистра статуса 1.                   S[7:0]
 #define W25_WRSR1               0x01                                            // запись регистра статуса 1.                   S[7:0]
 #define W25_RDSR2               0x35                                            // чтение регистра статуса 2.                   S[15:8]
@@ -126,27 +378,72 @@ typedef struct
 #define W25_RDSR3               0x15                                            // чтение регистра статуса 3.                   S[23:16]
 #define W25_WRSR3               0x11                                            // запись регистра статуса 3.                   S[23:16]
 
+// типовые и максимальные времена внутренних операций (мс)
+#define W25_TPP_MS              1                                               // программирование страницы
+#define W25_TPP_MAX_MS          3
+#define W25_TSE_MS              45                                              // стирание сектора 4 Кб
+#define W25_TSE_MAX_MS          400
+#define W25_TBE32_MS            120                                             // стирание блока 32 Кб
+#define W25_TBE32_MAX_MS        1600
+#define W25_TBE_MS              150                                             // стирание блока 64 Кб
+#define W25_TBE_MAX_MS          2000
+#define W25_TW_MS               15                                              // запись регистра состояния
+#define W25_TCE_MSMB            2500                                            // стирание чипа, на каждый мегабайт объёма
+#define W25_TCE_MAX_MSMB        12500
+#define W25_TRES1_US            3                                               // выход из глубокого сна (мкс)
+#define W25_TSUS_US             20                                              // приостановка программирования/стирания (мкс)
+
 // определения битов регистра состояния
 #define W25_SR1S0               (1 << 0)                                        // бит 0 регистра статуса 1: BUSY
+#define W25_SR2_QE              (1 << 1)                                        // бит 1 регистра статуса 2: QE (разрешение Quad-режимов)
+#define W25_SR2_SUS             (1 << 7)                                        // бит 7 регистра статуса 2: SUS (программирование/стирание приостановлено)
 
 // -------------- определения для м/сх FLASH-памяти серии MX25LXXXX --------------------
 // определения команд для м/сх серии mx25lXXXX
 #define MX25_MACRONIX           0xC2                                            // идентификатор производителя: Macronix
+#define MX25_SR_QE              (1 << 6)                                        // бит 6 регистра состояния: QE (разрешение Quad-режимов)
 
 
 // -----------------------------------------------------------------------------
 
-bool    Flash_Init      (void);
-void    Flash_Resume    (void);
-void    Flash_PowerDown (void);
-void    Flash_EraseChip (void);
-void    Flash_EraseArea (uint32_t page);
-void    Flash_WritePage (uint32_t page, uint32_t offset, uint32_t size, uint8_t *buf);
-void    Flash_ReadPage  (uint32_t page, uint32_t offset, uint32_t size, uint8_t *buf);
+bool    Flash_Init      (FLASH_t *dev);
+bool    Flash_Xfer      (FLASH_t *dev, const FLASH_Xfer_t *x);
+void    Flash_Resume    (FLASH_t *dev);
+bool    Flash_IsIdle    (FLASH_t *dev);
+void    Flash_WaitIdle  (FLASH_t *dev);
+void    Flash_PowerDown (FLASH_t *dev);
+void    Flash_IdleTask  (FLASH_t *dev);
+void    Flash_EraseChip (FLASH_t *dev);
+void    Flash_EraseArea (FLASH_t *dev, uint32_t area);
+bool    Flash_EraseRange(FLASH_t *dev, uint32_t start, uint32_t len);
+bool    Flash_WritePage (FLASH_t *dev, uint32_t page, uint32_t offset, uint32_t size, uint8_t *buf);
+bool    Flash_WritePages(FLASH_t *dev, uint32_t page, uint32_t count, uint8_t *buf);
+bool    Flash_Write     (FLASH_t *dev, uint32_t addr, uint32_t len, const uint8_t *buf);
+bool    Flash_UpdatePage(FLASH_t *dev, uint32_t page, uint32_t offset, uint32_t size, uint8_t *buf);
+void    Flash_ReadPage  (FLASH_t *dev, uint32_t page, uint32_t offset, uint32_t size, uint8_t *buf);
+bool    Flash_Read      (FLASH_t *dev, uint32_t addr, uint32_t len, uint8_t *buf);
+bool    Flash_ReadV     (FLASH_t *dev, uint32_t addr, const FLASH_Seg_t *seg, uint8_t count);
+bool    Flash_WriteV    (FLASH_t *dev, uint32_t page, uint32_t offset, const FLASH_Seg_t *seg, uint8_t count);
+void    Flash_DmaComplete (void *handle, bool ok);
+bool    Flash_GetStats  (FLASH_Stats_t *stats);
+void    Flash_ResetStats(void);
+uint32_t Flash_StatsSnapshot (uint8_t *buf, uint32_t size);
+bool    Flash_SchedInit (void);
+bool    Flash_Submit    (FLASH_Req_t *req);
+bool    Flash_SubmitWait(FLASH_Req_t *req);
 
 
 // -----------------------------------------------------------------------------
 
+bool    Flash_CacheRead      (FLASH_t *dev, uint32_t page, uint32_t offset, uint32_t size, uint8_t *buf);
+bool    Flash_CacheProg      (FLASH_t *dev, uint32_t page, uint32_t offset, uint32_t size, const uint8_t *buf);
+void    Flash_CacheInvalidate(FLASH_t *dev, uint32_t page, uint32_t count);
+bool    Flash_CacheSync      (FLASH_t *dev);
+
+void    Flash_LfsConfig      (FLASH_t *dev, struct lfs_config *cfg);
+bool    Flash_FtlInit        (FLASH_t *dev);
+bool    Flash_FtlTask        (FLASH_t *dev);
+
 int block_device_read   (const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size);
 int block_device_prog   (const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size);
 int block_device_erase  (const struct lfs_config *c, lfs_block_t block);
@@ -0,0 +1,170 @@
+/*
+ *  Замеры драйвера на модели м/сх: пропускная способность (МБ/с) и задержка операций по виртуальному времени модели
+ *  при заданной частоте SPI и накладных расходах вызова HAL, такты процессора ПК в коде драйвера (без времени внутри модели;
+ *  зависят от загрузки ПК и между запусками расходятся до десятков процентов - для сравнения сборок годится только размер кода).
+ *  Запуск: bench [-c частота SPI, Гц] [-o накладные расходы вызова HAL, нс] [-p w25q16 | at45 | at45bin]
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "check.h"
+
+typedef struct                                                                  // отметка начала замера
+{
+    uint64_t    Ns;                                                             // виртуальное время модели
+    uint32_t    Calls;                                                          // вызовы HAL
+    uint64_t    Cycles;                                                         // такты процессора ПК
+    uint64_t    Host;                                                           // из них проведённые внутри модели
+} BENCH_Mark_t;
+
+static uint8_t  buf[65536], ref[65536];
+
+static BENCH_Mark_t Bench_Mark (void)
+{
+    return (BENCH_Mark_t){ model.Ns, model.Calls, Model_Cycles (), model.HostCycles };
+}
+
+static void Bench_Print     (const char *name, BENCH_Mark_t m0, uint32_t ops, uint64_t bytes)  // строка таблицы: операций, мкс на операцию, МБ/с, вызовов HAL и тактов драйвера на операцию
+{
+    uint64_t  host          = model.HostCycles - m0.Host;                       // замер идёт до строки таблицы: printf в такты не входит
+    double    cycles        = (double)(Model_Cycles () - m0.Cycles - host);
+    double    us            = (double)(model.Ns - m0.Ns) / 1000.0;
+    printf                  ("%-24s %7u %11.1f %9.3f %9.1f %11.0f\n", name, ops, us / ops, bytes ? (double)bytes / us : 0.0,
+                             (double)(model.Calls - m0.Calls) / ops, cycles / ops);
+}
+
+static void Bench_Ops       (FLASH_t *dev)                                      // базовые операции: чтение и запись страниц, стирание областей
+{
+    uint16_t  pg            = dev->PgSize;
+    uint32_t  pages         = 256;
+    BENCH_Mark_t m          = Bench_Mark ();
+    for (uint32_t i = 0; i < dev->NumOfErasable && i < 64; i++)
+        Flash_EraseArea     (dev, i);
+    Flash_WaitIdle          (dev);
+    Bench_Print             ("EraseArea", m, dev->NumOfErasable < 64 ? dev->NumOfErasable : 64, 0);
+
+    Check_Fill              (buf, pg, 3);
+    m                       = Bench_Mark ();
+    for (uint32_t p = 0; p < pages; p++)
+        Flash_WritePage     (dev, p, 0, pg, buf);
+    Flash_WaitIdle          (dev);
+    Bench_Print             ("WritePage", m, pages, (uint64_t)pages * pg);
+
+    m                       = Bench_Mark ();
+    for (uint32_t p = 0; p < pages; p++)
+        Flash_ReadPage      (dev, p, 0, pg, buf);
+    Bench_Print             ("ReadPage", m, pages, (uint64_t)pages * pg);
+
+    m                       = Bench_Mark ();
+    for (uint32_t p = 0; p < pages; p++)
+        Flash_ReadPage      (dev, p, 0, 16, buf);
+    Bench_Print             ("ReadPage (16 B)", m, pages, (uint64_t)pages * 16);
+
+    uint32_t  run           = sizeof (buf) / pg;                                // массив из многих страниц: одна команда против цикла по страницам
+    m                       = Bench_Mark ();
+    Flash_Read              (dev, 0, run * pg, buf);
+    Bench_Print             ("Read (one call)", m, 1, (uint64_t)run * pg);
+    m                       = Bench_Mark ();
+    for (uint32_t p = 0; p < run; p++)
+        Flash_ReadPage      (dev, p, 0, pg, buf + p * pg);
+    Bench_Print             ("ReadPage loop", m, 1, (uint64_t)run * pg);
+}
+
+static void Bench_Lfs       (FLASH_t *dev)                                      // нагрузка LittleFS через функции-прокладки: фиксации метаданных в паре блоков, запись и чтение файлов
+{
+    struct lfs_config cfg   = {0};
+    Flash_LfsConfig         (dev, &cfg);
+    uint32_t  files         = 64;
+    uint32_t  fileBlocks    = (2048 + cfg.block_size - 1) / cfg.block_size;     // файл 2 Кб
+    uint32_t  commit        = (48 + cfg.prog_size - 1) / cfg.prog_size * cfg.prog_size;
+    uint32_t  meta          = 0, metaOff = 0, ops = 0;
+    uint64_t  bytes         = 0;
+    int       err           = 0;
+    err                    |= block_device_erase (&cfg, 0);
+    err                    |= block_device_erase (&cfg, 1);
+    memset                  (&flashCacheStats, 0, sizeof (flashCacheStats));
+    BENCH_Mark_t m          = Bench_Mark ();
+    for (uint32_t f = 0; f < files; f++)
+    {
+        uint32_t  first     = 2 + f * fileBlocks % (cfg.block_count - 2 - fileBlocks);
+        for (uint32_t b = 0; b < fileBlocks; b++, ops++)                        // данные файла: стирание блоков, запись буфером cache_size
+            err            |= block_device_erase (&cfg, first + b);
+        for (uint32_t off = 0; off < 2048; off += cfg.cache_size, ops++)
+        {
+            uint32_t  n     = 2048 - off < cfg.cache_size ? 2048 - off : cfg.cache_size;
+            n               = (n + cfg.prog_size - 1) / cfg.prog_size * cfg.prog_size;
+            Check_Fill      (buf, n, f * 4096 + off);
+            err            |= block_device_prog (&cfg, first + off / cfg.block_size, off % cfg.block_size, buf, n);
+            bytes          += n;
+        }
+        for (uint32_t r = 0; r < 4; r++, ops++)                                 // фиксация: чтение цепочки тегов, запись и синхронизация
+            err            |= block_device_read (&cfg, meta, (metaOff + r * cfg.read_size) % cfg.block_size, buf, cfg.read_size);
+        if (metaOff + commit > cfg.block_size)                                  // блок метаданных заполнен -> уплотнение в другой блок пары
+        {
+            meta           ^= 1;
+            metaOff         = 0;
+            err            |= block_device_erase (&cfg, meta);
+            ops++;
+        }
+        memset              (buf, (uint8_t)f, commit);
+        err                |= block_device_prog (&cfg, meta, metaOff, buf, commit);
+        err                |= block_device_sync (&cfg);
+        metaOff            += commit;
+        ops                += 2;
+        for (uint32_t off = 0; off < 2048; off += cfg.cache_size, ops++)        // чтение файла
+        {
+            uint32_t  n     = 2048 - off < cfg.cache_size ? 2048 - off : cfg.cache_size;
+            n               = (n + cfg.read_size - 1) / cfg.read_size * cfg.read_size;
+            err            |= block_device_read (&cfg, first + off / cfg.block_size, off % cfg.block_size, buf, n);
+            Check_Fill      (ref, n, f * 4096 + off);
+            CHECK           (memcmp (buf, ref, n) == 0);
+            bytes          += n;
+        }
+    }
+    Flash_WaitIdle          (dev);
+    CHECK                   (err == 0);
+    Bench_Print             ("LittleFS workload", m, ops, bytes);
+    if (flashCacheStats.Hits + flashCacheStats.Misses + flashCacheStats.Bypassed)  // кэш страниц: сборка по умолчанию
+        printf              ("  page cache: hits %u, misses %u, write-backs %u, bypassed pages %u\n", flashCacheStats.Hits,
+                             flashCacheStats.Misses, flashCacheStats.WriteBacks, flashCacheStats.Bypassed);
+    else                                                                        // сборка bench_nocache (-D_FLASH_CACHE_PAGES=0)
+        printf              ("  page cache: off\n");
+}
+
+int main                    (int argc, char **argv)
+{
+    uint32_t  hz            = 18000000;
+    uint32_t  callNs        = 2000;
+    const char *name        = "w25q16";
+    for (int opt; (opt = getopt (argc, argv, "c:o:p:")) != -1; )
+        switch (opt)
+        {
+            case 'c': hz     = (uint32_t)strtoul (optarg, NULL, 0); break;
+            case 'o': callNs = (uint32_t)strtoul (optarg, NULL, 0); break;
+            case 'p': name   = optarg; break;
+            default:
+                fprintf     (stderr, "bench [-c hz] [-o ns] [-p w25q16|at45|at45bin]\n");
+                return 2;
+        }
+    Model_Reset             (hz);
+    model.CallNs            = callNs;
+    MODEL_Chip_t *c         = Model_Attach (0, strncmp (name, "at45", 4) == 0 ? &modelAt45db161e : &modelW25q16, &modelSpi1);
+    c->Binary               = strcmp (name, "at45bin") == 0;
+    if (!Flash_Init (&flash))
+    {
+        printf              ("%s: not detected\n", name);
+        return 1;
+    }
+#if defined(_FLASH_FAMILY) && defined(_FLASH_PG_SHIFT)
+    printf                  ("%s, SPI %u Hz, HAL call %u ns, build _FLASH_FAMILY=%d _FLASH_PG_SHIFT=%d\n", c->Part->Name, hz, callNs,
+                             _FLASH_FAMILY, _FLASH_PG_SHIFT);                   // сборка под одно семейство и размер страницы
+#else
+    printf                  ("%s, SPI %u Hz, HAL call %u ns\n", c->Part->Name, hz, callNs);
+#endif
+    printf                  ("%-24s %7s %11s %9s %9s %11s\n", "op", "count", "us/op", "MB/s", "HAL/op", "cycles/op");
+    Bench_Ops               (&flash);
+    Bench_Lfs               (&flash);
+    CHECK                   (Check_Clean (c));
+    return checkFails ? 1 : 0;
+}
@@ -0,0 +1,39 @@
+/*
+ *  Общие средства тестов драйвера на модели м/сх: проверки и подготовка устройства.
+ */
+
+#ifndef _CHECK_H
+#define _CHECK_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "spiflash.h"
+#include "flash_model.h"
+
+static int checkFails;                                                          // количество не прошедших проверок
+
+#define CHECK(cond)             do { if (!(cond)) { printf ("%s:%d: не выполнено: %s\n", __FILE__, __LINE__, #cond); checkFails++; } } while (0)
+#define CHECK_DONE()            (printf ("%s: %s\n", __FILE__, checkFails ? "FAIL" : "OK"), checkFails ? 1 : 0)
+
+static inline bool Check_Init (FLASH_t *dev, uint8_t chip, const MODEL_Part_t *part, void *bus)  // подключение м/сх к модели и инициализация устройства
+{
+    Model_Attach            (chip, part, bus);
+    return Flash_Init (dev);
+}
+
+static inline void Check_Fill (uint8_t *buf, uint32_t len, uint32_t seed)       // заполнение буфера псевдослучайными байтами
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        seed                = seed * 1103515245u + 12345u;
+        buf[i]              = (uint8_t)(seed >> 16);
+    }
+}
+
+static inline bool Check_Clean (const MODEL_Chip_t *c)                          // обмен без нарушений протокола и конфликтов на шине
+{
+    return c->Violations == 0 && model.Conflicts == 0;
+}
+
+#endif
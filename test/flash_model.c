@@ -0,0 +1,494 @@
+/*
+ *  Поведенческая модель м/сх FLASH-памяти: разбор посылок по байтам, внутренние операции по виртуальному времени.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+#include "flash_model.h"
+#include "spiflash.h"                                                           // Flash_DmaComplete: модель играет роль обработчика завершения DMA
+
+MODEL_t  model;
+uint8_t  modelSpi1, modelSpi2;
+
+const MODEL_Part_t modelW25q16     = { .Name = "W25Q16", .Jedec = { 0xEF, 0x40, 0x15 }, .Pages = 8192, .PgSize = 256, .NoWrsr2 = true,
+                                       .TppUs = 700, .TeUs = { 45000, 120000, 150000 }, .TceUs = 4000000, .TwUs = 10000, .TsusUs = 20 };
+const MODEL_Part_t modelW25q256    = { .Name = "W25Q256", .Jedec = { 0xEF, 0x40, 0x19 }, .Pages = 131072, .PgSize = 256, .Addr4 = true,
+                                       .TppUs = 700, .TeUs = { 45000, 120000, 150000 }, .TceUs = 60000000, .TwUs = 10000, .TsusUs = 20 };
+const MODEL_Part_t modelAt45db161e = { .Name = "AT45DB161E", .Jedec = { 0x1F, 0x26, 0x00, 0x01, 0x00 }, .At45 = true, .Pages = 4096, .PgSize = 528,
+                                       .Density = 0x2C, .SectPages = 256, .TppUs = 14000, .TpUs = 2000, .TxfrUs = 200,
+                                       .TeUs = { 9000, 40000, 1500000 }, .TceUs = 14000000, .TsusUs = 50 };
+const MODEL_Part_t modelAt45db041e = { .Name = "AT45DB041E", .Jedec = { 0x1F, 0x24, 0x00, 0x01, 0x00 }, .At45 = true, .Pages = 2048, .PgSize = 264,
+                                       .Density = 0x1C, .SectPages = 256, .TppUs = 14000, .TpUs = 2000, .TxfrUs = 200,
+                                       .TeUs = { 9000, 40000, 1500000 }, .TceUs = 7000000, .TsusUs = 50 };
+
+uint64_t Model_Cycles       (void)                                              // счётчик тактов процессора ПК (или наносекунд, если тактов нет)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc          ();
+#else
+    struct timespec ts;
+    clock_gettime           (CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static uint64_t Model_Now   (void)
+{
+    return __atomic_load_n  (&model.Ns, __ATOMIC_RELAXED);
+}
+
+static void Model_Advance   (uint64_t ns)                                       // продвижение виртуального времени (задачи FreeRTOS на ПК - потоки)
+{
+    __atomic_add_fetch      (&model.Ns, ns, __ATOMIC_RELAXED);
+}
+
+uint32_t Model_Tick         (void)
+{
+    return (uint32_t)(Model_Now () / 1000000u);
+}
+
+void Model_SleepUs          (uint32_t us)
+{
+    Model_Advance           ((uint64_t)us * 1000u);
+}
+
+void Model_Reset            (uint32_t spiHz)                                    // сброс модели: м/сх отключаются, время и счётчики обнуляются
+{
+    for (uint8_t i = 0; i < MODEL_CHIPS; i++)
+        free                (model.Chip[i].Mem);
+    memset                  (&model, 0, sizeof (model));
+    model.SpiHz             = spiHz;
+}
+
+MODEL_Chip_t *Model_Attach  (uint8_t chip, const MODEL_Part_t *part, void *bus) // подключение м/сх к шине: выводы MODEL_PIN (chip, 1..3), память стёрта
+{
+    MODEL_Chip_t *c         = &model.Chip[chip];
+    free                    (c->Mem);
+    memset                  (c, 0, sizeof (*c));
+    c->Part                 = part;
+    c->Bus                  = bus;
+    c->BusyBuf              = 0xFF;
+    c->Mem                  = malloc ((size_t)part->Pages * part->PgSize);
+    memset                  (c->Mem, 0xFF, (size_t)part->Pages * part->PgSize);
+    memset                  (c->Sram, 0xFF, sizeof (c->Sram));
+    return c;
+}
+
+uint32_t Model_Offset       (const MODEL_Chip_t *c, uint32_t page)
+{
+    return page * c->Part->PgSize;
+}
+
+// ------------------------------- Внутренние операции: -------------------------------------------------------------------------------
+
+static void Model_Update    (MODEL_Chip_t *c)                                   // завершение операции, время которой истекло
+{
+    if (c->BusyOp && !c->Suspended && Model_Now () >= c->BusyUntil)
+    {
+        if (c->BusyUntil - c->OpStart > c->OpLongest)
+            c->OpLongest    = c->BusyUntil - c->OpStart;
+        c->BusyOp           = 0;
+        c->BusyBuf          = 0xFF;
+    }
+}
+
+static bool Model_Busy      (MODEL_Chip_t *c)                                   // м/сх занята: операция идёт или приостановка ещё не вступила в силу
+{
+    Model_Update            (c);
+    return c->BusyOp && Model_Now () < c->BusyUntil;
+}
+
+static void Model_Start     (MODEL_Chip_t *c, uint8_t op, uint32_t us, uint8_t buf)  // запуск внутренней операции (результат записан в память сразу)
+{
+    c->BusyOp               = op;
+    c->BusyBuf              = buf;
+    c->OpStart              = Model_Now ();
+    c->BusyUntil            = c->OpStart + (uint64_t)us * 1000u;
+}
+
+static void Model_Suspend   (MODEL_Chip_t *c)
+{
+    Model_Update            (c);
+    if (c->Part->NoSuspend || !c->BusyOp || c->Suspended || c->BusyOp == 0xC7 || c->BusyOp == 0x60 || c->BusyOp == 0x01 || c->BusyOp == 0x53 || c->BusyOp == 0x55)
+        return;                                                                 // приостанавливаются только программирование и стирание областей
+    c->Remaining            = c->BusyUntil - Model_Now ();
+    c->BusyUntil            = Model_Now () + (uint64_t)c->Part->TsusUs * 1000u;
+    c->Suspended            = true;
+    c->Suspends++;
+}
+
+static void Model_ResumeOp  (MODEL_Chip_t *c)
+{
+    if (!c->Suspended)
+        return;
+    c->Suspended            = false;
+    c->OpStart             -= Model_Now () > c->BusyUntil ? Model_Now () - c->BusyUntil : 0;  // длительность операции считается с временем приостановки
+    c->BusyUntil            = Model_Now () + c->Remaining;
+}
+
+static bool Model_Allowed   (MODEL_Chip_t *c, uint8_t cmd)                      // допустима ли команда в текущем состоянии м/сх
+{
+    if (c->Asleep)
+        return cmd == 0xAB;
+    if (cmd == 0x05 || cmd == 0x35 || cmd == 0x15 || cmd == 0xD7 || cmd == 0x75 || cmd == 0x7A || cmd == 0xB0 || cmd == 0xD0)
+        return true;                                                            // состояние, приостановка и возобновление - всегда
+    if (Model_Busy (c))
+        return c->Part->At45 && ((cmd == 0x84 && c->BusyBuf != 0) || (cmd == 0x87 && c->BusyBuf != 1));  // AT45DBXXX: запись свободного буфера
+    if (c->Suspended)
+        return cmd == 0x03 || cmd == 0x0B || cmd == 0x0C || cmd == 0x9F;        // приостановленная м/сх только читает
+    return true;
+}
+
+// ------------------------------- NOR (W25QXXX): -------------------------------------------------------------------------------------
+
+static uint8_t Model_AddrLen (uint8_t cmd)
+{
+    switch (cmd)
+    {
+        case 0x0C: case 0x12: case 0x21: case 0xDC:
+            return 4;
+        case 0x03: case 0x0B: case 0x02: case 0x20: case 0x52: case 0xD8: case 0x5A:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+static uint8_t Model_NorByte (MODEL_Chip_t *c, uint8_t cmd, uint32_t n, uint8_t in)
+{
+    uint32_t  size          = c->Part->Pages * c->Part->PgSize;
+    uint8_t   alen          = Model_AddrLen (cmd);
+    if (alen && n <= alen)
+    {
+        c->Addr             = (c->Addr << 8) | in;
+        if (n == alen && alen == 3)
+            c->Addr        &= 0xFFFFFF;                                         // 3-байтная команда: старшие биты адреса м/сх больше 16 Мб - нули
+        if (n == alen)
+            memset          (c->Latch, 0xFF, sizeof (c->Latch));
+        return 0xFF;
+    }
+    switch (cmd)
+    {
+        case 0x9F:
+            return n <= 5 ? c->Part->Jedec[n - 1] : 0xFF;
+        case 0x05:
+            return (Model_Busy (c) ? 0x01 : 0) | (c->Wel ? 0x02 : 0);
+        case 0x35:
+            return (c->Sr2 & 0x7F) | (c->Suspended ? 0x80 : 0);
+        case 0x03:
+        case 0x0B:
+        case 0x0C:
+            if (cmd != 0x03 && n == alen + 1u)
+                return 0xFF;                                                    // фиктивный байт
+            return c->Mem[c->Addr++ % size];
+        case 0x02:
+        case 0x12:
+            c->Latch[(c->Addr + n - alen - 1) & 0xFF] &= in;                    // защёлка страницы: лишние байты переписывают её начало
+            return 0xFF;
+        default:
+            return 0xFF;
+    }
+}
+
+static void Model_NorEnd    (MODEL_Chip_t *c, uint8_t cmd, uint32_t n)
+{
+    uint32_t  size          = c->Part->Pages * c->Part->PgSize;
+    uint8_t   alen          = Model_AddrLen (cmd);
+    uint32_t  region        = 0;
+    switch (cmd)
+    {
+        case 0x06: c->Wel   = true;  return;
+        case 0x04: c->Wel   = false; return;
+        case 0xB9: c->Asleep = true; return;
+        case 0xAB: c->Asleep = false; return;
+        case 0x75: Model_Suspend (c); return;
+        case 0x7A: Model_ResumeOp (c); return;
+        case 0x02:
+        case 0x12:
+            if (n <= alen + 1u)
+                return;
+            if (!c->Wel || (alen == 4 && !c->Part->Addr4))
+                break;
+            for (uint32_t i = 0, base = (c->Addr & ~0xFFu) % size; i < 256; i++)
+                c->Mem[base + i] &= c->Latch[i];                                // программирование: только 1 -> 0
+            c->Programs++;
+            c->Wel          = false;
+            Model_Start     (c, cmd, c->Part->TppUs, 0xFF);
+            return;
+        case 0x20: case 0x21: region = 4096;  break;
+        case 0x52:            region = 32768; break;
+        case 0xD8: case 0xDC: region = 65536; break;
+        case 0xC7:
+        case 0x60:
+            if (!c->Wel || n != 1)
+                break;
+            memset          (c->Mem, 0xFF, size);
+            c->Erases++;
+            c->Wel          = false;
+            Model_Start     (c, cmd, c->Part->TceUs, 0xFF);
+            return;
+        case 0x01:
+        case 0x31:
+            if (!c->Wel || (cmd == 0x31 && c->Part->NoWrsr2) || n < 2)
+                break;
+            if (cmd == 0x31 || n >= 3)
+                c->Sr2      = c->Frame[cmd == 0x31 ? 1 : 2] & 0x7F;
+            c->Wel          = false;
+            Model_Start     (c, 0x01, c->Part->TwUs, 0xFF);
+            return;
+        default:
+            return;
+    }
+    if (region && c->Wel && n == alen + 1u && (alen == 3 || c->Part->Addr4))
+    {
+        uint32_t  base      = (c->Addr % size) & ~(region - 1);
+        memset              (c->Mem + base, 0xFF, region);
+        c->Erases++;
+        c->Wel              = false;
+        Model_Start         (c, cmd, c->Part->TeUs[region == 4096 ? 0 : region == 32768 ? 1 : 2], 0xFF);
+        return;
+    }
+    c->Violations++;                                                            // запись/стирание без защёлки, неполный адрес или неподдерживаемая команда
+}
+
+// ------------------------------- AT45DBXXX: -----------------------------------------------------------------------------------------
+
+static uint16_t Model_At45Pg (const MODEL_Chip_t *c)                            // размер страницы в текущем режиме
+{
+    return c->Binary ? (uint16_t)(c->Part->PgSize & ~(c->Part->PgSize >> 5)) : c->Part->PgSize;
+}
+
+static uint8_t Model_At45Shift (const MODEL_Chip_t *c)                          // число битов смещения в адресе команды
+{
+    uint8_t   shift         = 0;
+    while ((1u << shift) < Model_At45Pg (c))
+        shift++;
+    return shift;
+}
+
+static uint32_t Model_At45Page (const MODEL_Chip_t *c)                          // страница из адреса посылки
+{
+    return (c->Addr >> Model_At45Shift (c)) % c->Part->Pages;
+}
+
+static uint8_t Model_At45Byte (MODEL_Chip_t *c, uint8_t cmd, uint32_t n, uint8_t in)
+{
+    uint16_t  pg            = Model_At45Pg (c);
+    if (cmd != 0x9F && cmd != 0xD7 && n <= 3)
+    {
+        c->Addr             = (c->Addr << 8) | in;
+        if (n == 3 && (cmd == 0x0B || cmd == 0x03))                             // чтение массива: адрес -> линейный индекс в текущем режиме
+            c->Addr         = Model_At45Page (c) * pg + (c->Addr & ((1u << Model_At45Shift (c)) - 1)) % pg;
+        return 0xFF;
+    }
+    switch (cmd)
+    {
+        case 0x9F:
+            return n <= 5 ? c->Part->Jedec[n - 1] : 0xFF;
+        case 0xD7:
+        {
+            bool      busy  = Model_Busy (c);
+            if (n & 1)
+                return (busy ? 0 : 0x80) | (c->Comp ? 0x40 : 0) | c->Part->Density | (c->Binary ? 0x01 : 0);
+            return (busy ? 0 : 0x80) | (c->Suspended ? 0x01 : 0);
+        }
+        case 0x0B:
+            if (n == 4)
+                return 0xFF;                                                    // фиктивный байт
+            // fallthrough
+        case 0x03:
+        {
+            uint32_t  idx   = c->Addr++ % (c->Part->Pages * pg);
+            return c->Mem[Model_Offset (c, idx / pg) + idx % pg];
+        }
+        case 0x84: case 0x87: case 0x82: case 0x85:
+        {
+            uint8_t   b     = (cmd == 0x84 || cmd == 0x82) ? 0 : 1;
+            uint32_t  off   = c->Addr & ((1u << Model_At45Shift (c)) - 1);
+            c->Sram[b][(off + n - 4) % pg] = in;                                // запись буфера: по кругу внутри страницы
+            return 0xFF;
+        }
+        default:
+            return 0xFF;
+    }
+}
+
+static void Model_At45End   (MODEL_Chip_t *c, uint8_t cmd, uint32_t n)
+{
+    uint16_t  pg            = Model_At45Pg (c);
+    uint32_t  page          = Model_At45Page (c);
+    uint8_t  *mem           = c->Mem + Model_Offset (c, page);
+    uint8_t   b             = (cmd == 0x83 || cmd == 0x88 || cmd == 0x82 || cmd == 0x53 || cmd == 0x60) ? 0 : 1;
+    uint32_t  first         = page, count = 0;
+    switch (cmd)
+    {
+        case 0xB9: c->Asleep = true;  return;
+        case 0xAB: c->Asleep = false; return;
+        case 0xB0: Model_Suspend (c); return;
+        case 0xD0: Model_ResumeOp (c); return;
+        case 0x83: case 0x86: case 0x88: case 0x89: case 0x82: case 0x85:
+            if (n < 4 || ((cmd == 0x82 || cmd == 0x85) && n == 4))
+                break;
+            for (uint16_t i = 0; i < pg; i++)
+                mem[i]      = (cmd == 0x88 || cmd == 0x89) ? mem[i] & c->Sram[b][i] : c->Sram[b][i];
+            c->Programs++;
+            Model_Start     (c, cmd, (cmd == 0x88 || cmd == 0x89) ? c->Part->TpUs : c->Part->TppUs, b);
+            return;
+        case 0x53: case 0x55:
+            if (n != 4)
+                break;
+            memcpy          (c->Sram[b], mem, pg);
+            Model_Start     (c, cmd, c->Part->TxfrUs, b);
+            return;
+        case 0x60: case 0x61:
+            if (n != 4)
+                break;
+            c->Comp         = memcmp (c->Sram[b], mem, pg) != 0;
+            Model_Start     (c, cmd, c->Part->TxfrUs, b);
+            return;
+        case 0x81: count = 1; break;
+        case 0x50: first = page & ~7u; count = 8; break;
+        case 0x7C:
+            first           = page / c->Part->SectPages * c->Part->SectPages;
+            count           = c->Part->SectPages;
+            if (first == 0)                                                     // сектор 0 делится на 0a (блок 0) и 0b (остальные страницы)
+            {
+                first       = page < 8 ? 0 : 8;
+                count       = page < 8 ? 8 : c->Part->SectPages - 8;
+            }
+            break;
+        case 0xC7:
+            if (n == 4 && c->Frame[1] == 0x94 && c->Frame[2] == 0x80 && c->Frame[3] == 0x9A)
+            {
+                memset      (c->Mem, 0xFF, (size_t)c->Part->Pages * c->Part->PgSize);
+                c->Erases++;
+                Model_Start (c, 0xC7, c->Part->TceUs, 0xFF);
+                return;
+            }
+            break;
+        case 0x3D:
+            if (n == 4 && c->Frame[1] == 0x2A && c->Frame[2] == 0x80 && (c->Frame[3] == 0xA6 || c->Frame[3] == 0xA7))
+            {
+                c->Binary   = c->Frame[3] == 0xA6;
+                Model_Start (c, 0x01, c->Part->TppUs, 0xFF);
+                return;
+            }
+            break;
+        default:
+            return;
+    }
+    if (count && n == 4)
+    {
+        for (uint32_t p = first; p < first + count; p++)
+            memset          (c->Mem + Model_Offset (c, p), 0xFF, c->Part->PgSize);
+        c->Erases++;
+        Model_Start         (c, cmd, c->Part->TeUs[cmd == 0x81 ? 0 : cmd == 0x50 ? 1 : 2], 0xFF);
+        return;
+    }
+    c->Violations++;                                                            // неполная посылка или неверная последовательность байтов
+}
+
+// ------------------------------- Шина и выводы: -------------------------------------------------------------------------------------
+
+static uint8_t Model_Byte   (MODEL_Chip_t *c, uint8_t in)
+{
+    uint32_t  n             = c->N++;
+    if (n < sizeof (c->Frame))
+        c->Frame[n]         = in;
+    if (n == 0)
+    {
+        c->Cmds[in]++;
+        c->Addr             = 0;
+        if (!Model_Allowed (c, in))
+        {
+            c->Violations++;                                                    // команда спящей/занятой м/сх: м/сх её не видит
+            c->Ignore       = true;
+        }
+        return 0xFF;
+    }
+    if (c->Ignore)
+        return 0xFF;
+    return c->Part->At45 ? Model_At45Byte (c, c->Frame[0], n, in) : Model_NorByte (c, c->Frame[0], n, in);
+}
+
+static MODEL_Chip_t *Model_Selected (void *bus)                                 // м/сх, выбранная на шине
+{
+    for (uint8_t i = 0; i < MODEL_CHIPS; i++)
+        if (model.Chip[i].Part && model.Chip[i].Bus == bus && model.Chip[i].Selected)
+            return &model.Chip[i];
+    return NULL;
+}
+
+int Model_Xfer              (void *bus, const uint8_t *tx, uint8_t *rx, uint32_t len)  // передача по шине (0 - HAL_OK, 1 - HAL_ERROR)
+{
+    uint64_t  t0            = Model_Cycles ();
+    model.Calls++;
+    if (model.FailCalls)
+    {
+        model.FailCalls--;
+        model.HostCycles   += Model_Cycles () - t0;
+        return 1;
+    }
+    Model_Advance           (model.CallNs + (uint64_t)len * 8000000000u / model.SpiHz);
+    model.Bytes            += len;
+    MODEL_Chip_t *c         = Model_Selected (bus);
+    for (uint32_t i = 0; i < len; i++)
+    {
+        uint8_t   out       = c ? Model_Byte (c, tx ? tx[i] : 0xFF) : 0xFF;
+        if (rx)
+            rx[i]           = out;
+    }
+    model.HostCycles       += Model_Cycles () - t0;
+    return 0;
+}
+
+int Model_RxDma             (void *bus, uint8_t *rx, uint32_t len)              // приём по DMA: данные приходят сразу, завершение сообщается драйверу
+{
+    model.DmaCalls++;
+    int       st            = Model_Xfer (bus, NULL, rx, len);
+    if (st == 0)
+        Flash_DmaComplete   (bus, true);
+    return st;
+}
+
+void Model_Abort            (void *bus)
+{
+    (void)bus;
+}
+
+void Model_Pin              (uint16_t pin, bool high)                           // уровень вывода м/сх: CS - начало/конец посылки, RST - сброс
+{
+    uint64_t  t0            = Model_Cycles ();
+    MODEL_Chip_t *c         = &model.Chip[(pin - 1) / 4 % MODEL_CHIPS];
+    uint8_t   n             = (uint8_t)(pin - (pin - 1) / 4 * 4);
+    if (c->Part == NULL)
+        return;
+    if (n == 1 && !high && !c->Selected)
+    {
+        if (Model_Selected (c->Bus))
+            model.Conflicts++;                                                  // на шине уже выбрана другая м/сх
+        c->Selected         = true;
+        c->Selects++;
+        c->N                = 0;
+        c->Ignore           = false;
+    }
+    else if (n == 1 && high && c->Selected)
+    {
+        c->Selected         = false;
+        if (c->N && !c->Ignore)
+            c->Part->At45 ? Model_At45End (c, c->Frame[0], c->N) : Model_NorEnd (c, c->Frame[0], c->N);
+    }
+    else if (n == 3 && !high)                                                   // сброс: операция прерывается, м/сх просыпается
+    {
+        c->BusyOp           = 0;
+        c->Suspended        = false;
+        c->Asleep           = false;
+        c->Wel              = false;
+    }
+    model.HostCycles       += Model_Cycles () - t0;
+}
@@ -0,0 +1,103 @@
+/*
+ *  Поведенческая модель м/сх FLASH-памяти для сборки драйвера на ПК (порт port_host.h).
+ *  Особенности модели:
+ *      - м/сх AT45DBXXX (SRAM-буферы, страница 2^n + 2^(n-5) или 2^n байт, сравнение с буфером) и NOR (W25QXXX: защёлка записи, 3/4-байтный адрес)
+ *      - ответ на 0x9F, регистр состояния и занятость по времени внутренних операций, программирование только 1 -> 0, стирание, сон 0xB9/0xAB
+ *      - приостановка/возобновление программирования и стирания (0x75/0x7A, 0xB0/0xD0)
+ *      - время виртуальное: каждый байт на шине занимает 8 тактов SPI заданной частоты, вызов HAL - заданные накладные расходы
+ *      - нарушения протокола (команда занятой или спящей м/сх, запись без 0x06, два Chip Select на одной шине) считаются, а не прерывают работу
+ */
+
+#ifndef _FLASH_MODEL_H
+#define _FLASH_MODEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MODEL_CHIPS             4                                               // наибольшее количество м/сх в модели
+#define MODEL_PIN(chip, n)      ((uint16_t)((chip) * 4 + (n)))                  // номера выводов м/сх: 1 - CS, 2 - WP, 3 - RST
+
+typedef struct                                                                  // описание моделируемой м/сх
+{
+    const char *Name;                                                           // название
+    uint8_t     Jedec[5];                                                       // ответ на команду 0x9F
+    bool        At45;                                                           // true - AT45DBXXX, false - NOR
+    uint32_t    Pages;                                                          // количество страниц
+    uint16_t    PgSize;                                                         // размер страницы (AT45DBXXX: в режиме DataFlash)
+    uint8_t     Density;                                                        // AT45DBXXX: биты 5-2 регистра состояния
+    uint16_t    SectPages;                                                      // AT45DBXXX: страниц в секторе
+    bool        Addr4;                                                          // NOR: поддерживаются команды с 4-байтным адресом
+    bool        NoWrsr2;                                                        // NOR: команда 0x31 не поддерживается (ранние W25Q)
+    bool        NoSuspend;                                                      // приостановка не поддерживается: команда игнорируется
+    uint32_t    TppUs;                                                          // программирование страницы (AT45DBXXX: со стиранием)
+    uint32_t    TpUs;                                                           // AT45DBXXX: программирование без стирания
+    uint32_t    TxfrUs;                                                         // AT45DBXXX: передача страницы в буфер и сравнение
+    uint32_t    TeUs[3];                                                        // стирание: NOR - сектор/32K/64K, AT45DBXXX - страница/блок/сектор
+    uint32_t    TceUs;                                                          // стирание чипа
+    uint32_t    TwUs;                                                           // запись регистра состояния
+    uint32_t    TsusUs;                                                         // время до вступления приостановки в силу
+} MODEL_Part_t;
+
+typedef struct                                                                  // состояние моделируемой м/сх
+{
+    const MODEL_Part_t *Part;
+    void       *Bus;                                                            // шина, к которой подключена м/сх
+    uint8_t    *Mem;                                                            // массив памяти
+    uint8_t     Sram[2][1056];                                                  // AT45DBXXX: SRAM-буферы
+    uint8_t     Latch[256];                                                     // NOR: буфер программируемой страницы
+    bool        Selected;                                                       // Chip Select активен
+    bool        Ignore;                                                         // остаток посылки игнорируется (команда спящей или занятой м/сх)
+    bool        Wel;                                                            // NOR: защёлка записи
+    bool        Asleep;                                                         // м/сх спит (0xB9)
+    bool        Binary;                                                         // AT45DBXXX: страница 2^n байт
+    bool        Comp;                                                           // AT45DBXXX: результат сравнения (true - различаются)
+    uint8_t     Sr2;                                                            // NOR: регистр состояния 2 (QE, SUS)
+    uint8_t     BusyOp;                                                         // команда, выполняемая м/сх (0 - свободна)
+    uint8_t     BusyBuf;                                                        // AT45DBXXX: SRAM-буфер, занятый операцией (0xFF - никакой)
+    uint64_t    BusyUntil;                                                      // момент завершения операции (нс)
+    uint64_t    Remaining;                                                      // оставшееся время приостановленной операции (нс)
+    bool        Suspended;                                                      // операция приостановлена
+    uint8_t     Frame[8];                                                       // команда и адрес текущей посылки
+    uint32_t    N;                                                              // принято байтов в текущей посылке
+    uint32_t    Addr;                                                           // текущий адрес фазы данных
+    uint32_t    Cmds[256];                                                      // количество посылок по кодам команд
+    uint32_t    Selects;                                                        // количество Chip Select
+    uint32_t    Programs;                                                       // выполненные программирования
+    uint32_t    Erases;                                                         // выполненные стирания
+    uint32_t    Suspends;                                                       // приостановки, вступившие в силу
+    uint32_t    Violations;                                                     // нарушения протокола
+    uint64_t    OpStart;                                                        // начало последней операции (нс)
+    uint64_t    OpLongest;                                                      // наибольшая длительность операции от запуска до завершения (нс)
+} MODEL_Chip_t;
+
+typedef struct                                                                  // общее состояние модели
+{
+    uint64_t    Ns;                                                             // виртуальное время (нс)
+    uint32_t    SpiHz;                                                          // частота SPI
+    uint32_t    CallNs;                                                         // накладные расходы одного вызова HAL (нс)
+    uint32_t    Calls;                                                          // вызовы HAL передачи (включая DMA)
+    uint32_t    DmaCalls;                                                       // запуски приёма по DMA
+    uint32_t    Bytes;                                                          // байты на шинах
+    uint32_t    Conflicts;                                                      // одновременно активные Chip Select на одной шине
+    uint32_t    FailCalls;                                                      // >0 -> столько следующих вызовов HAL завершаются ошибкой
+    uint64_t    HostCycles;                                                     // такты процессора ПК, проведённые внутри модели
+    MODEL_Chip_t Chip[MODEL_CHIPS];
+} MODEL_t;
+
+extern MODEL_t model;
+extern uint8_t modelSpi1, modelSpi2;                                            // шины: идентифицируются адресом
+
+extern const MODEL_Part_t modelW25q16, modelW25q256, modelAt45db161e, modelAt45db041e;
+
+void          Model_Reset     (uint32_t spiHz);
+MODEL_Chip_t *Model_Attach    (uint8_t chip, const MODEL_Part_t *part, void *bus);
+int           Model_Xfer      (void *bus, const uint8_t *tx, uint8_t *rx, uint32_t len);
+int           Model_RxDma     (void *bus, uint8_t *rx, uint32_t len);
+void          Model_Abort     (void *bus);
+void          Model_Pin       (uint16_t pin, bool high);
+uint32_t      Model_Tick      (void);
+void          Model_SleepUs   (uint32_t us);
+uint64_t      Model_Cycles    (void);
+uint32_t      Model_Offset    (const MODEL_Chip_t *c, uint32_t page);           // смещение страницы в массиве памяти модели
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ *  FreeRTOS на потоках POSIX для сборки драйвера на ПК с _FLASH_USE_FREERTOS = 1 (интерфейс - stub/cmsis_os.h).
+ *  Задачи выполняются параллельно, поэтому тесты проверяют и захваты драйвера: обращения к модели м/сх одной шины
+ *  разделяет только мьютекс драйвера. Семафоры и уведомления ждут на общей условной переменной.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "cmsis_os.h"
+#include "flash_model.h"
+
+typedef struct                                                                  // задача: поток и её уведомления
+{
+    TaskFunction_t  Fn;
+    void           *Arg;
+    uint32_t        Notify[configTASK_NOTIFICATION_ARRAY_ENTRIES];
+} HOST_Task_t;
+
+typedef struct                                                                  // семафор (мьютекс - двоичный семафор, изначально свободный)
+{
+    uint32_t        Count;
+} HOST_Sem_t;
+
+static pthread_mutex_t  hostLock = PTHREAD_MUTEX_INITIALIZER;                   // состояние всех семафоров и уведомлений
+static pthread_cond_t   hostCond = PTHREAD_COND_INITIALIZER;                    // изменение любого из них
+static pthread_mutex_t  hostIrq;                                                // "запрет прерываний": общий рекурсивный мьютекс
+static pthread_once_t   hostIrqOnce = PTHREAD_ONCE_INIT;
+static __thread HOST_Task_t *hostSelf;                                          // задача текущего потока
+
+static void Host_IrqInit    (void)
+{
+    pthread_mutexattr_t a;
+    pthread_mutexattr_init  (&a);
+    pthread_mutexattr_settype (&a, PTHREAD_MUTEX_RECURSIVE);                    // секции с запретом прерываний бывают вложенными
+    pthread_mutex_init      (&hostIrq, &a);
+    pthread_mutexattr_destroy (&a);
+}
+
+void host_irq_off           (void)
+{
+    pthread_once            (&hostIrqOnce, Host_IrqInit);
+    pthread_mutex_lock      (&hostIrq);
+}
+
+void host_irq_on            (void)
+{
+    pthread_mutex_unlock    (&hostIrq);
+}
+
+static bool Host_Wait       (TickType_t ticks, const struct timespec *until)    // ожидание изменения под hostLock: false - время вышло
+{
+    if (ticks == portMAX_DELAY)
+        return pthread_cond_wait (&hostCond, &hostLock) == 0;
+    return pthread_cond_timedwait (&hostCond, &hostLock, until) == 0;
+}
+
+static struct timespec Host_Deadline (TickType_t ticks)                         // момент окончания ожидания (реальное время)
+{
+    struct timespec t;
+    clock_gettime           (CLOCK_REALTIME, &t);
+    if (ticks != portMAX_DELAY)
+    {
+        t.tv_sec           += ticks / 1000;
+        t.tv_nsec          += (long)(ticks % 1000) * 1000000L;
+        t.tv_sec           += t.tv_nsec / 1000000000L;
+        t.tv_nsec          %= 1000000000L;
+    }
+    return t;
+}
+
+static void *Host_Thread    (void *arg)
+{
+    hostSelf                = arg;
+    hostSelf->Fn            (hostSelf->Arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate      (TaskFunction_t fn, const char *name, uint16_t stack, void *arg, UBaseType_t prio, TaskHandle_t *task)
+{
+    pthread_t               th;
+    HOST_Task_t *t          = calloc (1, sizeof (*t));
+    (void)name;
+    (void)stack;
+    (void)prio;
+    if (t == NULL)
+        return pdFAIL;
+    t->Fn                   = fn;
+    t->Arg                  = arg;
+    if (task)                                                                   // до запуска потока: задача может сразу получить уведомление
+        *task               = t;
+    if (pthread_create (&th, NULL, Host_Thread, t) != 0)
+    {
+        if (task)
+            *task           = NULL;
+        free                (t);
+        return pdFAIL;
+    }
+    pthread_detach          (th);
+    return pdPASS;
+}
+
+void vTaskDelete            (TaskHandle_t task)
+{
+    (void)task;                                                                 // запись задачи остаётся: на неё могут прийти уведомления
+    pthread_exit            (NULL);
+}
+
+void vTaskDelay             (TickType_t ticks)
+{
+    Model_SleepUs           (ticks * 1000u);                                    // время модели идёт, пока задача спит
+    sched_yield             ();
+}
+
+TickType_t xTaskGetTickCount (void)
+{
+    return Model_Tick       ();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle (void)
+{
+    if (hostSelf == NULL)                                                       // main и другие потоки, созданные не через xTaskCreate
+        hostSelf            = calloc (1, sizeof (*hostSelf));
+    return hostSelf;
+}
+
+BaseType_t xTaskNotifyGiveIndexed (TaskHandle_t task, UBaseType_t index)
+{
+    HOST_Task_t *t          = task;
+    pthread_mutex_lock      (&hostLock);
+    t->Notify[index]++;
+    pthread_cond_broadcast  (&hostCond);
+    pthread_mutex_unlock    (&hostLock);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTakeIndexed (UBaseType_t index, BaseType_t clear, TickType_t ticks)
+{
+    HOST_Task_t *t          = xTaskGetCurrentTaskHandle ();
+    struct timespec until   = Host_Deadline (ticks);
+    uint32_t                n;
+    pthread_mutex_lock      (&hostLock);
+    while (t->Notify[index] == 0 && ticks && Host_Wait (ticks, &until));
+    n                       = t->Notify[index];
+    if (n)
+        t->Notify[index]    = clear ? 0 : n - 1;
+    pthread_mutex_unlock    (&hostLock);
+    return n;
+}
+
+static SemaphoreHandle_t Host_SemCreate (uint32_t count)
+{
+    HOST_Sem_t *s           = calloc (1, sizeof (*s));
+    if (s)
+        s->Count            = count;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex (void)
+{
+    return Host_SemCreate   (1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary (void)
+{
+    return Host_SemCreate   (0);
+}
+
+BaseType_t xSemaphoreTake   (SemaphoreHandle_t sem, TickType_t ticks)
+{
+    HOST_Sem_t *s           = sem;
+    struct timespec until   = Host_Deadline (ticks);
+    BaseType_t              ok;
+    pthread_mutex_lock      (&hostLock);
+    while (s->Count == 0 && ticks && Host_Wait (ticks, &until));
+    ok                      = s->Count ? pdTRUE : pdFALSE;
+    if (ok)
+        s->Count--;
+    pthread_mutex_unlock    (&hostLock);
+    return ok;
+}
+
+BaseType_t xSemaphoreGive   (SemaphoreHandle_t sem)
+{
+    HOST_Sem_t *s           = sem;
+    BaseType_t              ok;
+    pthread_mutex_lock      (&hostLock);
+    ok                      = s->Count == 0 ? pdTRUE : pdFALSE;                 // двоичный семафор: повторная выдача не накапливается
+    s->Count                = 1;
+    pthread_cond_broadcast  (&hostCond);
+    pthread_mutex_unlock    (&hostLock);
+    sched_yield             ();                                                 // точка переключения: ожидавшая задача может обогнать выдавшую
+    return ok;
+}
+
+BaseType_t xSemaphoreGiveFromISR (SemaphoreHandle_t sem, BaseType_t *woken)
+{
+    if (woken)
+        *woken              = pdFALSE;
+    return xSemaphoreGive   (sem);
+}
+
+TimerHandle_t xTimerCreate  (const char *name, TickType_t period, UBaseType_t reload, void *id, TimerCallbackFunction_t fn)
+{
+    (void)name;
+    (void)period;
+    (void)reload;
+    (void)id;
+    (void)fn;
+    return NULL;
+}
+
+BaseType_t xTimerStart      (TimerHandle_t timer, TickType_t ticks)
+{
+    (void)timer;
+    (void)ticks;
+    return pdFAIL;
+}
@@ -0,0 +1,58 @@
+/*
+ *  Порт драйвера для сборки на ПК: обращения к HAL, выводам и шине SPI идут в модель м/сх (flash_model.c).
+ *  Подключается ключом -D_FLASH_PORT="port_host.h"; настройки драйвера с #ifndef переопределяются ключами -D.
+ *  Устройство по умолчанию (flash) - м/сх 0 модели на шине modelSpi1; завершение DMA модель сообщает через Flash_DmaComplete.
+ */
+
+#ifndef _FLASH_PORT_HOST_H
+#define _FLASH_PORT_HOST_H
+
+#include <stddef.h>
+
+#include "flash_model.h"
+
+typedef enum                                                                    // результат вызова HAL (как в STM32 HAL)
+{
+    HAL_OK                  = 0,
+    HAL_ERROR,
+    HAL_BUSY,
+    HAL_TIMEOUT,
+} HAL_StatusTypeDef;
+
+#define DELAY                   100                                             // пауза после сброса м/сх (на плате - из equipment.h)
+
+#define _FLASH_SPI              modelSpi1                                       // м/сх по умолчанию: м/сх 0 модели
+#define _FLASH_CS_GPIO          NULL
+#define _FLASH_CS_PIN           MODEL_PIN (0, 1)
+#define _FLASH_WP_GPIO          NULL
+#define _FLASH_WP_PIN           MODEL_PIN (0, 2)
+#define _FLASH_RST_GPIO         NULL
+#define _FLASH_RST_PIN          MODEL_PIN (0, 3)
+
+#ifndef _FLASH_USE_FREERTOS
+#define _FLASH_USE_FREERTOS     0                                               // =1 -> FreeRTOS на потоках ПК (host_rtos.c)
+#endif
+
+#if (_FLASH_USE_FREERTOS == 1)
+    void host_irq_off (void);
+    void host_irq_on  (void);
+    #define _FLASH_IRQ_OFF()                host_irq_off ()
+    #define _FLASH_IRQ_ON()                 host_irq_on ()
+#else
+    #define _FLASH_DELAY(ms)                Model_SleepUs ((uint32_t)(ms) * 1000u)
+    #define _FLASH_IRQ_OFF()
+    #define _FLASH_IRQ_ON()
+#endif
+#define _FLASH_TICK()                       Model_Tick ()
+#define _FLASH_DELAY_US(us)                 Model_SleepUs (us)
+#define _FLASH_PIN(gpio, pin, high)         Model_Pin (pin, high)
+#define _FLASH_SPI_TX(bus, buf, len, tmo)       ((HAL_StatusTypeDef)Model_Xfer (bus, buf, NULL, len))
+#define _FLASH_SPI_RX(bus, buf, len, tmo)       ((HAL_StatusTypeDef)Model_Xfer (bus, NULL, buf, len))
+#define _FLASH_SPI_TXRX(bus, tx, rx, len, tmo)  ((HAL_StatusTypeDef)Model_Xfer (bus, tx, rx, len))
+#define _FLASH_SPI_RX_DMA(bus, buf, len)        ((HAL_StatusTypeDef)Model_RxDma (bus, buf, len))
+#define _FLASH_SPI_ABORT(bus)                   Model_Abort (bus)
+#define _FLASH_CYCLES_INIT()
+#define _FLASH_CYCLES()                     ((uint32_t)(model.Ns / 1000u))      // статистика драйвера - по виртуальному времени модели
+#define _FLASH_CYCLES_PER_US                1
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ *  Часть интерфейса FreeRTOS (CMSIS-RTOS), которой пользуется драйвер: для сборки тестов с _FLASH_USE_FREERTOS = 1 на ПК.
+ *  Реализация - host_rtos.c: задачи - потоки POSIX, выполняются параллельно; приоритеты и размеры стеков не учитываются,
+ *  один тик - 1 мс реального времени, задержки задач (osDelay, vTaskDelay) продвигают и виртуальное время модели.
+ */
+
+#ifndef CMSIS_OS_H
+#define CMSIS_OS_H
+
+#include <stdint.h>
+
+typedef long                    BaseType_t;
+typedef unsigned long           UBaseType_t;
+typedef uint32_t                TickType_t;
+typedef void                   *TaskHandle_t;
+typedef void                   *SemaphoreHandle_t;
+typedef void                   *TimerHandle_t;
+typedef void                  (*TaskFunction_t)         (void *arg);
+typedef void                  (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFF)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))                              // тик - 1 мс
+#define tskIDLE_PRIORITY        ((UBaseType_t)0)
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES   3                               // уведомлений у каждой задачи
+
+#define portYIELD_FROM_ISR(woken)               ((void)(woken))
+
+BaseType_t        xTaskCreate               (TaskFunction_t fn, const char *name, uint16_t stack, void *arg, UBaseType_t prio, TaskHandle_t *task);
+void              vTaskDelete               (TaskHandle_t task);                // только NULL: завершение текущей задачи
+void              vTaskDelay                (TickType_t ticks);
+TickType_t        xTaskGetTickCount         (void);
+TaskHandle_t      xTaskGetCurrentTaskHandle (void);                             // поток, не созданный xTaskCreate (main), тоже получает задачу
+BaseType_t        xTaskNotifyGiveIndexed    (TaskHandle_t task, UBaseType_t index);
+uint32_t          ulTaskNotifyTakeIndexed   (UBaseType_t index, BaseType_t clear, TickType_t ticks);
+#define xTaskNotifyGive(task)                   xTaskNotifyGiveIndexed (task, 0)
+#define ulTaskNotifyTake(clear, ticks)          ulTaskNotifyTakeIndexed (0, clear, ticks)
+
+SemaphoreHandle_t xSemaphoreCreateMutex     (void);                             // без наследования приоритета и рекурсии
+SemaphoreHandle_t xSemaphoreCreateBinary    (void);
+BaseType_t        xSemaphoreTake            (SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t        xSemaphoreGive            (SemaphoreHandle_t sem);
+BaseType_t        xSemaphoreGiveFromISR     (SemaphoreHandle_t sem, BaseType_t *woken);
+
+TimerHandle_t     xTimerCreate              (const char *name, TickType_t period, UBaseType_t reload, void *id, TimerCallbackFunction_t fn);  // таймеры не моделируются: NULL
+BaseType_t        xTimerStart               (TimerHandle_t timer, TickType_t ticks);
+
+#define osDelay(ms)                             vTaskDelay (pdMS_TO_TICKS (ms))
+
+#endif
@@ -0,0 +1,38 @@
+/*
+ *  Часть интерфейса LittleFS, которой пользуются функции-прокладки драйвера: для сборки тестов без исходников LittleFS.
+ */
+
+#ifndef LFS_H
+#define LFS_H
+
+#include <stdint.h>
+
+typedef uint32_t lfs_size_t;
+typedef uint32_t lfs_off_t;
+typedef uint32_t lfs_block_t;
+
+enum lfs_error
+{
+    LFS_ERR_OK              = 0,                                                // нет ошибки
+    LFS_ERR_IO              = -5,                                               // ошибка устройства
+    LFS_ERR_CORRUPT         = -84,                                              // повреждённые данные
+    LFS_ERR_INVAL           = -22,                                              // неверный аргумент
+};
+
+struct lfs_config
+{
+    void       *context;
+    int       (*read)  (const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size);
+    int       (*prog)  (const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size);
+    int       (*erase) (const struct lfs_config *c, lfs_block_t block);
+    int       (*sync)  (const struct lfs_config *c);
+    lfs_size_t  read_size;
+    lfs_size_t  prog_size;
+    lfs_size_t  block_size;
+    lfs_size_t  block_count;
+    int32_t     block_cycles;
+    lfs_size_t  cache_size;
+    lfs_size_t  lookahead_size;
+};
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ *  4-байтный адрес на модели W25Q256 (32 Мб): страницы в каждом мегабайте и у границы 16 Мб пишутся, читаются и стираются
+ *  командами 0x12/0x0C/0x21, команды с 3-байтным адресом не используются.
+ */
+
+#include "check.h"
+
+#define ADDR4_MB                (1024u * 1024u)
+
+static uint8_t  wr[512], rd[512];
+
+static void Addr4_Tag       (uint8_t *buf, uint32_t addr)                       // страница с адресом в начале: чтение по чужому адресу заметно
+{
+    Check_Fill              (buf, 256, addr);
+    memcpy                  (buf, &addr, sizeof (addr));
+}
+
+int main                    (void)
+{
+    static const uint32_t edge[] = { 16 * ADDR4_MB - 8192, 16 * ADDR4_MB, 16 * ADDR4_MB + 4096 };  // страницы у границы 16 Мб (в других секторах)
+    uint32_t  addrs[32 + 3], count = 0;
+    for (uint32_t mb = 0; mb < 32; mb++)                                        // последняя страница каждого мегабайта: старший байт адреса меняется на следующей
+        addrs[count++]      = (mb + 1) * ADDR4_MB - 256;
+    for (uint32_t i = 0; i < 3; i++)
+        addrs[count++]      = edge[i];
+
+    Model_Reset             (20000000);
+    MODEL_Chip_t *c         = &model.Chip[0];
+    CHECK                   (Check_Init (&flash, 0, &modelW25q256, &modelSpi1));
+    CHECK                   (flash.AddrLen == 4 && flash.Pages == 131072 && flash.PgSize == 256);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        CHECK               (Flash_EraseRange (&flash, addrs[i] & ~4095u, 4096));
+        Addr4_Tag           (wr, addrs[i]);
+        CHECK               (Flash_Write (&flash, addrs[i], 256, wr));
+    }
+    Flash_WaitIdle          (&flash);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        Addr4_Tag           (wr, addrs[i]);
+        CHECK               (Flash_Read (&flash, addrs[i], 256, rd) && memcmp (rd, wr, 256) == 0);
+        CHECK               (memcmp (c->Mem + addrs[i], wr, 256) == 0);         // страница в массиве модели по тому же адресу
+    }
+
+    Addr4_Tag               (wr, 16 * ADDR4_MB - 256);                          // одно чтение через границу 16 Мб
+    Addr4_Tag               (wr + 256, 16 * ADDR4_MB);
+    CHECK                   (Flash_Read (&flash, 16 * ADDR4_MB - 256, 512, rd) && memcmp (rd, wr, 512) == 0);
+
+    CHECK                   (c->Cmds[0x21] == count && c->Cmds[0x12] == count && c->Cmds[0x0C] == count + 1);
+    CHECK                   (c->Cmds[0x20] == 0 && c->Cmds[0x02] == 0 && c->Cmds[0x03] == 0 && c->Cmds[0x0B] == 0);
+    CHECK                   (Check_Clean (c));
+    return CHECK_DONE       ();
+}
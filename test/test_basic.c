@@ -0,0 +1,150 @@
+/*
+ *  Основные операции драйвера на модели м/сх: опознание, чтение/запись/стирание, сон (NOR и AT45DBXXX в обоих режимах страницы).
+ */
+
+#include <stdlib.h>
+
+#include "check.h"
+
+static uint8_t  wr[8192], rd[8192];
+
+static void Test_Nor        (void)
+{
+    Model_Reset             (8000000);
+    MODEL_Chip_t *c         = &model.Chip[0];
+    CHECK                   (Check_Init (&flash, 0, &modelW25q16, &modelSpi1));
+    CHECK                   (flash.Family == FLASH_FAMILY_NOR && flash.PgSize == 256 && flash.Pages == 8192);
+    CHECK                   (flash.ErasableSize == 4096 && flash.NumOfErasable == 512);
+
+    Check_Fill              (wr, 3000, 1);                                      // запись через границы страниц
+    CHECK                   (Flash_Write (&flash, 1000, 3000, wr));
+    memset                  (rd, 0, sizeof (rd));
+    CHECK                   (Flash_Read (&flash, 1000, 3000, rd));
+    CHECK                   (memcmp (wr, rd, 3000) == 0);
+    CHECK                   (memcmp (c->Mem + 1000, wr, 3000) == 0);
+
+    uint8_t   zero[16]      = {0};                                              // программирование только сбрасывает биты
+    memset                  (wr, 0xF0, 16);
+    CHECK                   (Flash_Write (&flash, 8192, 16, wr));
+    CHECK                   (Flash_Write (&flash, 8192, 16, zero));
+    CHECK                   (Flash_Read (&flash, 8192, 16, rd) && memcmp (rd, zero, 16) == 0);
+
+    Flash_WaitIdle          (&flash);                                           // ошибка HAL при записи части страницы доходит до вызывающего
+    model.FailCalls         = 1;
+    CHECK                   (!Flash_WritePage (&flash, 48, 8, 16, wr));
+    Flash_WaitIdle          (&flash);                                           // неудачная запись оставляет ожидание завершения: опрос занятости
+    model.FailCalls         = 1;
+    CHECK                   (!Flash_Write (&flash, 49 * 256 + 8, 16, wr));
+    CHECK                   (c->Mem[48 * 256 + 8] == 0xFF && c->Mem[49 * 256 + 8] == 0xFF);
+    CHECK                   (Flash_Write (&flash, 49 * 256 + 8, 16, wr));
+    uint32_t  programs      = c->Programs;                                      // страница за концом м/сх не программируется (адрес не заворачивается на начало)
+    CHECK                   (!Flash_WritePage (&flash, flash.Pages, 0, 16, wr) && !Flash_WritePage (&flash, 0xFFFFFFFF, 0, 16, wr));
+    CHECK                   (c->Programs == programs);
+
+    CHECK                   (!Flash_EraseRange (&flash, 4096, 0xFFFFF000));     // диапазон за концом м/сх (start + len переполняется) не стирается
+    CHECK                   (!Flash_EraseRange (&flash, 2 * 1024 * 1024 - 4096, 8192));
+    CHECK                   (c->Erases == 0);
+    Flash_WaitIdle          (&flash);                                           // ошибка HAL: стирание не началось, следующая операция его не ждёт
+    model.FailCalls         = 1;
+    CHECK                   (!Flash_EraseRange (&flash, 0, 4096));
+    CHECK                   (flash.Pending == FLASH_OP_NONE && c->Erases == 0);
+    CHECK                   (Flash_EraseRange (&flash, 0, 4096));               // стирание сектора
+    CHECK                   (Flash_Read (&flash, 0, 4096, rd));
+    bool      blank         = true;
+    for (uint32_t i = 0; i < 4096; i++)
+        blank              &= rd[i] == 0xFF;
+    CHECK                   (blank);
+
+    Flash_PowerDown         (&flash);                                           // сон: следующее обращение будит м/сх
+    CHECK                   (c->Asleep && flash.Asleep);
+    CHECK                   (Flash_Read (&flash, 8192, 16, rd) && memcmp (rd, zero, 16) == 0);
+    CHECK                   (!c->Asleep);
+    CHECK                   (Check_Clean (c));
+}
+
+static void Test_At45       (bool binary)
+{
+    Model_Reset             (8000000);
+    MODEL_Chip_t *c         = Model_Attach (0, &modelAt45db161e, &modelSpi1);
+    c->Binary               = binary;
+    CHECK                   (Flash_Init (&flash));
+    uint16_t  pg            = binary ? 512 : 528;
+    CHECK                   (flash.Family == FLASH_FAMILY_AT45 && flash.PgSize == pg && flash.Pages == 4096);
+
+    Check_Fill              (wr, 4 * pg, 2);                                    // целые страницы: буферы по очереди
+    CHECK                   (Flash_WritePages (&flash, 5, 4, wr));
+    CHECK                   (Flash_Read (&flash, 5 * pg, 4 * pg, rd) && memcmp (wr, rd, 4 * pg) == 0);
+    for (uint32_t p = 0; p < 4; p++)
+        CHECK               (memcmp (c->Mem + Model_Offset (c, 5 + p), wr + p * pg, pg) == 0);
+
+    uint8_t   patch[10];                                                        // часть страницы: остальные байты сохраняются
+    memset                  (patch, 0x5A, sizeof (patch));
+    CHECK                   (Flash_Write (&flash, 6 * pg + 100, sizeof (patch), patch));
+    memcpy                  (wr + pg + 100, patch, sizeof (patch));
+    CHECK                   (Flash_Read (&flash, 5 * pg, 4 * pg, rd) && memcmp (wr, rd, 4 * pg) == 0);
+
+    CHECK                   (Flash_EraseRange (&flash, 8 * pg, 8 * pg));        // блок из 8 страниц
+    CHECK                   (Flash_Read (&flash, 5 * pg, 3 * pg, rd) && memcmp (wr, rd, 3 * pg) == 0);
+    CHECK                   (Flash_Read (&flash, 8 * pg, 1, rd) && rd[0] == 0xFF);
+
+    Flash_PowerDown         (&flash);
+    CHECK                   (c->Asleep);
+    CHECK                   (Flash_Read (&flash, 5 * pg, pg, rd) && memcmp (wr, rd, pg) == 0);
+    CHECK                   (Check_Clean (c));
+}
+
+static void Test_SlowProgram (void)
+{
+    MODEL_Part_t slow       = modelAt45db161e;                                  // программирование дольше типового (15 мс), но в пределах максимального (35 мс)
+    slow.TppUs              = 30000;
+    Model_Reset             (8000000);
+    MODEL_Chip_t *c         = Model_Attach (0, &slow, &modelSpi1);
+    CHECK                   (Flash_Init (&flash));
+    Check_Fill              (wr, flash.PgSize, 3);
+    CHECK                   (Flash_WritePage (&flash, 2, 0, flash.PgSize, wr));
+    uint32_t  polls         = flash.BusyPolls;
+    Flash_WaitIdle          (&flash);                                           // после сна на типовое время - опрос раз в миллисекунду, а не непрерывно
+    CHECK                   (flash.BusyPolls - polls <= 20 && flash.PendingTimeouts == 0);
+    CHECK                   (memcmp (c->Mem + Model_Offset (c, 2), wr, flash.PgSize) == 0);
+    CHECK                   (Check_Clean (c));
+}
+
+static void Test_StuckXfer  (void)
+{
+    MODEL_Part_t stuck      = modelAt45db161e;                                  // передача страницы в буфер (0x53) не завершается за AT45_TXFR_MAX_MS
+    stuck.TxfrUs            = 50000;
+    Model_Reset             (8000000);
+    MODEL_Chip_t *c         = Model_Attach (0, &stuck, &modelSpi1);
+    CHECK                   (Flash_Init (&flash));
+    uint8_t   patch[10];
+    memset                  (patch, 0x5A, sizeof (patch));
+    uint32_t  t0            = Model_Tick ();
+    CHECK                   (!Flash_Write (&flash, 3 * flash.PgSize + 100, sizeof (patch), patch));
+    CHECK                   (Model_Tick () - t0 <= AT45_TXFR_MAX_MS + 2 && flash.PendingTimeouts == 1);
+    CHECK                   (c->Programs == 0);                                 // страница не программируется из недописанного буфера
+    Model_SleepUs           (stuck.TxfrUs);
+    Flash_WaitIdle          (&flash);
+    CHECK                   (Flash_Read (&flash, 3 * flash.PgSize + 100, sizeof (patch), rd) && rd[0] == 0xFF);
+
+    flash.WriteAvoid        = true;                                             // сравнение страницы с буфером (0x60) тоже не завершается
+    Check_Fill              (wr, flash.PgSize, 4);
+    t0                      = Model_Tick ();
+    CHECK                   (!Flash_WritePage (&flash, 4, 0, flash.PgSize, wr));
+    CHECK                   (Model_Tick () - t0 <= AT45_TXFR_MAX_MS + 2 && flash.PendingTimeouts == 2);
+    CHECK                   (c->Programs == 0 && flash.SkippedWrites == 0);
+    Model_SleepUs           (stuck.TxfrUs);
+    flash.WriteAvoid        = false;
+    CHECK                   (Check_Clean (c));
+}
+
+int main                    (void)
+{
+    FLASH_Stats_t st;
+    CHECK                   (!Flash_GetStats (&st));                            // статистика по умолчанию не компилируется
+    Test_Nor                ();
+    Test_At45               (false);
+    Test_At45               (true);
+    Test_SlowProgram        ();
+    Test_StuckXfer          ();
+    return CHECK_DONE       ();
+}
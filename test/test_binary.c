@@ -0,0 +1,32 @@
+/*
+ *  Перевод AT45DBXXX на страницу 2^n байт при опознании (сборка с -D_FLASH_AT45_BINARY=1): м/сх со страницей 264 байта
+ *  получает последовательность 0x3D 0x2A 0x80 0xA6, а геометрия берётся из повторно прочитанного регистра состояния.
+ */
+
+#include "check.h"
+
+static uint8_t  wr[256], rd[256];
+
+int main                    (void)
+{
+    Model_Reset             (8000000);
+    MODEL_Chip_t *c         = Model_Attach (0, &modelAt45db041e, &modelSpi1);
+    CHECK                   (!c->Binary);                                       // режим "DataFlash": страница 264 байта
+    CHECK                   (Flash_Init (&flash));
+    CHECK                   (c->Cmds[0x3D] == 1 && c->Binary);                  // модель включает режим 2^n только на 0x3D 0x2A 0x80 0xA6
+    CHECK                   (c->Cmds[0xD7] >= 2);                               // состояние до и после перевода
+    CHECK                   (flash.Family == FLASH_FAMILY_AT45 && flash.PgSize == 256 && flash.Pages == 2048);
+
+    Check_Fill              (wr, sizeof (wr), 5);                               // линейный адрес - по страницам 256 байт
+    CHECK                   (Flash_Write (&flash, 7 * 256, sizeof (wr), wr));
+    CHECK                   (Flash_Read (&flash, 7 * 256, sizeof (rd), rd) && memcmp (wr, rd, sizeof (rd)) == 0);
+    CHECK                   (memcmp (c->Mem + Model_Offset (c, 7), wr, sizeof (wr)) == 0);
+
+    Model_Reset             (8000000);                                          // м/сх уже в режиме 2^n: перевод не повторяется
+    c                       = Model_Attach (0, &modelAt45db041e, &modelSpi1);
+    c->Binary               = true;
+    CHECK                   (Flash_Init (&flash));
+    CHECK                   (c->Cmds[0x3D] == 0 && flash.PgSize == 256 && flash.Pages == 2048);
+    CHECK                   (Check_Clean (c));
+    return CHECK_DONE       ();
+}
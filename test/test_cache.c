@@ -0,0 +1,115 @@
+/*
+ *  Кэш страниц функций-прокладок LittleFS на модели м/сх: согласованность с прямыми записями и стираниями, отложенная запись,
+ *  ошибки записи строк (синхронизация и вытеснение) доходят до вызывающего, а строка остаётся изменённой; непрочитанная страница
+ *  в кэш не попадает.
+ */
+
+#include "check.h"
+
+static uint8_t  wr[4096], rd[4096];
+
+static void Test_Coherence  (void)
+{
+    Model_Reset             (8000000);
+    MODEL_Chip_t *c         = &model.Chip[0];
+    CHECK                   (Check_Init (&flash, 0, &modelW25q16, &modelSpi1));
+    memset                  (&flashCacheStats, 0, sizeof (flashCacheStats));
+
+    CHECK                   (Flash_CacheRead (&flash, 1, 8, 16, rd));           // страница 1 загружается в кэш
+    CHECK                   (flashCacheStats.Misses == 1);
+    Check_Fill              (wr, 16, 1);                                        // прямая запись мимо кэша
+    CHECK                   (Flash_Write (&flash, 256 + 8, 16, wr));
+    CHECK                   (Flash_CacheRead (&flash, 1, 8, 16, rd) && memcmp (rd, wr, 16) == 0);
+    CHECK                   (flashCacheStats.Misses == 2);                      // строка удалена, страница загружена заново
+
+    CHECK                   (Flash_EraseRange (&flash, 0, 4096));               // прямое стирание сектора со страницей в кэше
+    CHECK                   (Flash_CacheRead (&flash, 1, 8, 16, rd));
+    bool      blank         = true;
+    for (uint32_t i = 0; i < 16; i++)
+        blank              &= rd[i] == 0xFF;
+    CHECK                   (blank);
+
+    Check_Fill              (wr, 256, 2);                                       // целые страницы мимо кэша
+    CHECK                   (Flash_CacheRead (&flash, 3, 0, 16, rd));
+    CHECK                   (Flash_WritePages (&flash, 3, 1, wr));
+    CHECK                   (Flash_CacheRead (&flash, 3, 0, 16, rd) && memcmp (rd, wr, 16) == 0);
+    CHECK                   (Check_Clean (c));
+}
+
+static void Test_WriteBack  (void)
+{
+    Model_Reset             (8000000);
+    MODEL_Chip_t *c         = &model.Chip[0];
+    CHECK                   (Check_Init (&flash, 0, &modelW25q16, &modelSpi1));
+    memset                  (&flashCacheStats, 0, sizeof (flashCacheStats));
+
+    Check_Fill              (wr, 64, 3);                                        // две частичные записи в одну страницу объединяются
+    CHECK                   (Flash_CacheProg (&flash, 2, 0, 32, wr));
+    CHECK                   (Flash_CacheProg (&flash, 2, 32, 32, wr + 32));
+    CHECK                   (c->Programs == 0);
+    CHECK                   (Flash_WritePage (&flash, 4, 0, 16, wr));           // прямая запись другой страницы не трогает изменённую строку
+    CHECK                   (c->Programs == 1);
+    Flash_CacheSync         (&flash);
+    CHECK                   (c->Programs == 2 && flashCacheStats.WriteBacks == 1);
+    CHECK                   (memcmp (c->Mem + 2 * 256, wr, 64) == 0);
+    CHECK                   (Flash_CacheRead (&flash, 2, 0, 64, rd) && memcmp (rd, wr, 64) == 0);
+    CHECK                   (flashCacheStats.Hits == 2);                        // строка остаётся в кэше после синхронизации
+    CHECK                   (Check_Clean (c));
+}
+
+static void Test_Errors     (void)
+{
+    Model_Reset             (8000000);
+    MODEL_Chip_t *c         = &model.Chip[0];
+    CHECK                   (Check_Init (&flash, 0, &modelW25q16, &modelSpi1));
+    Flash_CacheInvalidate   (&flash, 0, flash.Pages);                           // строки предыдущих проверок
+    memset                  (&flashCacheStats, 0, sizeof (flashCacheStats));
+
+    Check_Fill              (wr, 32, 4);                                        // синхронизация: ошибка HAL при записи строки
+    CHECK                   (Flash_CacheProg (&flash, 2, 0, 32, wr));
+    model.FailCalls         = 1;
+    CHECK                   (!Flash_CacheSync (&flash));
+    CHECK                   (c->Programs == 0 && flashCacheStats.WriteBacks == 0);
+    CHECK                   (Flash_CacheSync (&flash));                         // строка осталась изменённой и записывается повторно
+    CHECK                   (c->Programs == 1 && memcmp (c->Mem + 2 * 256, wr, 32) == 0);
+
+    struct lfs_config cfg   = {0};                                              // то же через функцию-прокладку
+    Flash_LfsConfig         (&flash, &cfg);
+    CHECK                   (block_device_prog (&cfg, 1, 16, wr, 16) == LFS_ERR_OK);
+    model.FailCalls         = 1;
+    CHECK                   (block_device_sync (&cfg) == LFS_ERR_IO);
+    CHECK                   (block_device_sync (&cfg) == LFS_ERR_OK);
+    CHECK                   (memcmp (c->Mem + cfg.block_size + 16, wr, 16) == 0);
+
+    for (uint32_t p = 0; p < 4; p++)                                            // вытеснение: все строки изменены, запись вытесняемой не удалась
+        CHECK               (Flash_CacheProg (&flash, 20 + p, 8, 8, wr));
+    uint32_t  evictions     = flashCacheStats.Evictions;
+    model.FailCalls         = 1;
+    CHECK                   (!Flash_CacheProg (&flash, 30, 0, 8, wr));
+    CHECK                   (flashCacheStats.Evictions == evictions);
+    CHECK                   (Flash_CacheSync (&flash));                         // все четыре страницы дошли до м/сх
+    uint32_t  hits          = flashCacheStats.Hits;
+    for (uint32_t p = 0; p < 4; p++)
+        CHECK               (memcmp (c->Mem + (20 + p) * 256 + 8, wr, 8) == 0);
+    CHECK                   (c->Mem[30 * 256] == 0xFF);
+
+    uint8_t   buf[8];                                                           // промах: ошибка HAL при загрузке страницы -> строка не заполняется
+    uint32_t  per           = cfg.block_size / 256;
+    model.FailCalls         = 1;
+    CHECK                   (block_device_read (&cfg, 40 / per, 40 % per * 256 + 8, buf, sizeof (buf)) == LFS_ERR_IO);
+    memset                  (buf, 0, sizeof (buf));
+    CHECK                   (block_device_read (&cfg, 40 / per, 40 % per * 256 + 8, buf, sizeof (buf)) == LFS_ERR_OK);
+    bool      blank         = true;                                             // повторное чтение - с м/сх, а не из строки с чужими данными
+    for (uint32_t i = 0; i < sizeof (buf); i++)
+        blank              &= buf[i] == 0xFF;
+    CHECK                   (blank && flashCacheStats.Hits == hits);
+    CHECK                   (Check_Clean (c));
+}
+
+int main                    (void)
+{
+    Test_Coherence          ();
+    Test_WriteBack          ();
+    Test_Errors             ();
+    return CHECK_DONE       ();
+}
@@ -0,0 +1,46 @@
+/*
+ *  Несколько м/сх: список инициализированных устройств ограничен _FLASH_DEVICES (лишняя м/сх не инициализируется),
+ *  виртуальное устройство FLASH_STRIPE пишет и стирает обе м/сх под своим захватом.
+ */
+
+#include "check.h"
+
+static FLASH_t  dev1        = FLASH_DEVICE (&modelSpi1, NULL, MODEL_PIN (1, 1), NULL, MODEL_PIN (1, 2), NULL, MODEL_PIN (1, 3));
+static FLASH_t  dev2        = FLASH_DEVICE (&modelSpi2, NULL, MODEL_PIN (2, 1), NULL, MODEL_PIN (2, 2), NULL, MODEL_PIN (2, 3));
+static FLASH_t  dev3        = FLASH_DEVICE (&modelSpi2, NULL, MODEL_PIN (3, 1), NULL, MODEL_PIN (3, 2), NULL, MODEL_PIN (3, 3));
+static FLASH_t  extra       = FLASH_DEVICE (&modelSpi2, NULL, MODEL_PIN (3, 1), NULL, MODEL_PIN (3, 2), NULL, MODEL_PIN (3, 3));
+static FLASH_t  raid        = FLASH_STRIPE (&dev2, &dev3);
+
+static uint8_t  wr[4096], rd[4096];
+
+int main                    (void)
+{
+    Model_Reset             (8000000);
+    Model_Attach            (0, &modelW25q16, &modelSpi1);
+    Model_Attach            (1, &modelW25q16, &modelSpi1);
+    Model_Attach            (2, &modelW25q16, &modelSpi2);
+    Model_Attach            (3, &modelW25q16, &modelSpi2);
+    CHECK                   (Flash_Init (&flash) && Flash_Init (&dev1) && Flash_Init (&dev2) && Flash_Init (&dev3));
+    CHECK                   (Flash_Init (&flash));                              // повторная инициализация не занимает новое место в списке
+
+    uint32_t  calls         = model.Calls;                                      // пятая м/сх: места в списке нет -> ошибка без обращений к шине
+    CHECK                   (!Flash_Init (&extra) && extra.Id == 0 && model.Calls == calls);
+    CHECK                   (!Flash_Write (&extra, 0, 16, wr));
+
+    CHECK                   (Flash_Init (&raid) && raid.Pages == 2 * dev2.Pages);  // виртуальное устройство не занимает место в списке
+    Check_Fill              (wr, sizeof (wr), 7);
+    CHECK                   (Flash_EraseRange (&raid, 0, raid.ErasableSize));
+    CHECK                   (Flash_Write (&raid, 0, sizeof (wr), wr));
+    CHECK                   (!raid.Busy && !dev2.Busy && !dev3.Busy);           // захваты освобождены
+    CHECK                   (Flash_Read (&raid, 0, sizeof (rd), rd) && memcmp (rd, wr, sizeof (wr)) == 0);
+    CHECK                   (memcmp (model.Chip[2].Mem, wr, 256) == 0 && memcmp (model.Chip[3].Mem, wr + 256, 256) == 0);
+    CHECK                   (model.Chip[2].Erases == 1 && model.Chip[3].Erases == 1);
+    uint8_t   patch[16];                                                        // часть страницы: тоже под захватом виртуального устройства
+    memset                  (patch, 0x5A, sizeof (patch));
+    CHECK                   (Flash_EraseRange (&raid, 0, raid.ErasableSize) && Flash_WritePage (&raid, 3, 10, sizeof (patch), patch));
+    CHECK                   (!raid.Busy && !dev2.Busy && !dev3.Busy);
+    CHECK                   (memcmp (model.Chip[3].Mem + 256 + 10, patch, sizeof (patch)) == 0);
+    for (uint8_t i = 0; i < 4; i++)
+        CHECK               (Check_Clean (&model.Chip[i]));
+    return CHECK_DONE       ();
+}
@@ -0,0 +1,59 @@
+/*
+ *  Слой трансляции блоков (сборка с -D_FLASH_USE_FTL=1): м/сх с числом блоков больше _FLASH_FTL_BLOCKS не принимается,
+ *  проверка блока на стёртость - одна команда чтения на блок, работа функций-прокладок LittleFS через FTL,
+ *  блок с неудавшимся стиранием остаётся вне запаса.
+ */
+
+#include "check.h"
+
+static FLASH_t  big         = FLASH_DEVICE (&modelSpi2, NULL, MODEL_PIN (1, 1), NULL, MODEL_PIN (1, 2), NULL, MODEL_PIN (1, 3));
+
+static uint8_t  wr[256], rd[256];
+
+int main                    (void)
+{
+    Model_Reset             (20000000);
+    MODEL_Chip_t *c         = Model_Attach (0, &modelW25q16, &modelSpi1);       // 512 блоков по 4 Кб
+    Model_Attach            (1, &modelW25q256, &modelSpi2);                     // 8192 блока: больше _FLASH_FTL_BLOCKS
+    CHECK                   (Flash_Init (&flash) && Flash_Init (&big));
+    CHECK                   (!Flash_FtlInit (&big) && big.Ftl == NULL);
+
+    memset                  (c->Mem + 5 * 4096 + 100, 0x00, 16);                // новая м/сх: блок 5 не стёрт, остальные стёрты
+    CHECK                   (Flash_FtlInit (&flash) && flash.Ftl != NULL);
+    uint32_t  selects       = c->Selects, reads = c->Cmds[0x0B];
+    uint32_t  steps         = 0;
+    for (; Flash_FtlTask (&flash); steps++)                                     // шаги фоновой задачи с паузой _FLASH_FTL_POLL_MS
+        Model_SleepUs       (5000);
+    Flash_WaitIdle          (&flash);
+    CHECK                   (c->Erases == 1);                                   // стирается только блок 5
+    CHECK                   (c->Cmds[0x0B] - reads == 511 + 1);                 // проверка стёртости: одна команда чтения на блок (блок 5 - до первого отличия)
+    CHECK                   (c->Selects - selects <= 4 * 512 + 8);              // на блок: чтение, 0x06 и программирование заголовка, опрос состояния
+    CHECK                   (steps >= 512);
+
+    struct lfs_config cfg   = {0};
+    Flash_LfsConfig         (&flash, &cfg);
+    CHECK                   (cfg.block_count == 512 - 8);                       // без запаса
+    Check_Fill              (wr, sizeof (wr), 9);
+    CHECK                   (block_device_erase (&cfg, 3) == LFS_ERR_OK);
+    CHECK                   (block_device_prog (&cfg, 3, 256, wr, sizeof (wr)) == LFS_ERR_OK);
+    CHECK                   (block_device_sync (&cfg) == LFS_ERR_OK);
+    CHECK                   (block_device_read (&cfg, 3, 256, rd, sizeof (rd)) == LFS_ERR_OK && memcmp (rd, wr, sizeof (wr)) == 0);
+    CHECK                   (block_device_erase (&cfg, 3) == LFS_ERR_OK);       // повторное стирание - другой физический блок, данные стёрты
+    CHECK                   (block_device_read (&cfg, 3, 256, rd, sizeof (rd)) == LFS_ERR_OK && rd[0] == 0xFF && rd[255] == 0xFF);
+    CHECK                   (c->Erases == 1);                                   // прежний блок стирает фоновый шаг
+    while (Flash_FtlTask (&flash))
+        Model_SleepUs       (5000);
+    Flash_WaitIdle          (&flash);
+    CHECK                   (c->Erases == 2);
+
+    CHECK                   (block_device_erase (&cfg, 3) == LFS_ERR_OK);       // ошибка команды стирания: блок не попадает в запас нестёртым
+    Flash_WaitIdle          (&flash);                                           // запись заголовка нового блока завершена: ошибку получит команда стирания
+    model.FailCalls         = 1;
+    CHECK                   (!Flash_FtlTask (&flash) && c->Erases == 2 && flash.Pending == FLASH_OP_NONE);
+    while (Flash_FtlTask (&flash))                                              // следующие шаги повторяют стирание
+        Model_SleepUs       (5000);
+    Flash_WaitIdle          (&flash);
+    CHECK                   (c->Erases == 3);
+    CHECK                   (Check_Clean (c) && Check_Clean (&model.Chip[1]));
+    return CHECK_DONE       ();
+}
@@ -0,0 +1,33 @@
+/*
+ *  Автоматическое усыпление после простоя (сборка с -D_FLASH_IDLE_MS=10): Flash_IdleTask не ждёт занятую м/сх,
+ *  а делает не больше одного чтения состояния и усыпляет её при следующей проверке.
+ */
+
+#include "check.h"
+
+int main                    (void)
+{
+    MODEL_Part_t slow       = modelW25q16;                                      // стирание сектора в модели втрое дольше ожидаемого драйвером
+    Model_Reset             (8000000);
+    MODEL_Chip_t *c         = &model.Chip[0];
+    CHECK                   (Check_Init (&flash, 0, &slow, &modelSpi1));
+    slow.TeUs[0]            = flash.Desc.Erase[2].Ms * 3000u;
+
+    CHECK                   (Flash_EraseRange (&flash, 0, 4096));
+    uint32_t  calls         = model.Calls;
+    Flash_IdleTask          (&flash);                                           // простой не истёк: обращений к шине нет
+    CHECK                   (model.Calls == calls && !flash.Asleep);
+
+    Model_SleepUs           ((flash.Desc.Erase[2].Ms + 20) * 1000u);            // ожидаемое время стирания и простой истекли, м/сх ещё стирает
+    uint64_t  t0            = model.Ns;
+    Flash_IdleTask          (&flash);
+    CHECK                   (model.Calls == calls + 1 && model.Ns - t0 < 1000000u);  // одно чтение состояния, без ожидания
+    CHECK                   (!flash.Asleep && c->Cmds[0xB9] == 0 && c->BusyOp != 0);
+
+    Model_SleepUs           (slow.TeUs[0]);                                     // стирание завершилось
+    Flash_IdleTask          (&flash);
+    CHECK                   (flash.Asleep && c->Asleep && c->Cmds[0xB9] == 1);
+    CHECK                   (c->Erases == 1);
+    CHECK                   (Check_Clean (c));
+    return CHECK_DONE       ();
+}
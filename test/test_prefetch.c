@@ -0,0 +1,43 @@
+/*
+ *  Упреждающее чтение на общей шине: две м/сх на modelSpi1. Без BusOwner упреждение не запускается (Chip Select приёма
+ *  остался бы активным при обмене с другой м/сх), с BusOwner обмен другой м/сх сначала завершает приём. Конфликтов на шине нет.
+ */
+
+#include "check.h"
+
+static FLASH_t  dev1        = FLASH_DEVICE (&modelSpi1, NULL, MODEL_PIN (1, 1), NULL, MODEL_PIN (1, 2), NULL, MODEL_PIN (1, 3));
+
+static uint8_t  wr[2048], rd[256];
+
+static void Prefetch_Run    (void)                                              // чтения подряд с flash, затем обращение к dev1
+{
+    for (uint32_t i = 0; i < 3; i++)
+        CHECK               (Flash_Read (&flash, i * 256, 256, rd) && memcmp (rd, wr + i * 256, 256) == 0);
+    CHECK                   (Flash_Read (&dev1, 0, 16, rd) && memcmp (rd, wr + 1024, 16) == 0);
+    CHECK                   (Flash_Read (&flash, 4 * 256, 256, rd) && memcmp (rd, wr + 4 * 256, 256) == 0);
+}
+
+int main                    (void)
+{
+    Model_Reset             (8000000);
+    Model_Attach            (0, &modelW25q16, &modelSpi1);
+    Model_Attach            (1, &modelW25q16, &modelSpi1);
+    CHECK                   (Flash_Init (&flash) && Flash_Init (&dev1));
+    CHECK                   (flash.Prefetch != NULL && dev1.Prefetch == NULL);  // кольцо одно: у первой м/сх
+    Check_Fill              (wr, sizeof (wr), 5);
+    CHECK                   (Flash_Write (&flash, 0, sizeof (wr), wr));
+    CHECK                   (Flash_Write (&dev1, 0, 16, wr + 1024));
+    Flash_WaitIdle          (&flash);
+    Flash_WaitIdle          (&dev1);
+
+    memset                  (&flashPrefetchStats, 0, sizeof (flashPrefetchStats));  // шина общая, BusOwner не указан -> упреждения нет
+    Prefetch_Run            ();
+    CHECK                   (flashPrefetchStats.Loads == 0 && model.Conflicts == 0);
+
+    dev1.BusOwner           = &flash;                                           // dev1 захватывает мьютекс flash -> упреждение разрешено
+    memset                  (&flashPrefetchStats, 0, sizeof (flashPrefetchStats));
+    Prefetch_Run            ();
+    CHECK                   (flashPrefetchStats.Loads == 1 && flashPrefetchStats.Hits == 1 && model.Conflicts == 0);
+    CHECK                   (Check_Clean (&model.Chip[0]) && Check_Clean (&model.Chip[1]));
+    return CHECK_DONE       ();
+}
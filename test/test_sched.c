@@ -0,0 +1,121 @@
+/*
+ *  Планировщик запросов под нагрузкой: несколько задач (потоки host_rtos.c) одновременно пишут, читают и стирают свои области
+ *  через Flash_SubmitWait и читают общую область и мимо планировщика. Данные сверяются с копией каждой задачи,
+ *  Flash_SubmitWait не забирает уведомление задачи с индексом 0.
+ */
+
+#include "check.h"
+#include "cmsis_os.h"
+
+#define SCHED_CLIENTS           4                                               // задачи-клиенты
+#define SCHED_STEPS             150                                             // запросов каждой задачи
+#define SCHED_AREA              8192                                            // своя область задачи (два сектора)
+#define SCHED_SHARED            (1024u * 1024u)                                 // общая область только для чтения
+#define SCHED_SHARED_LEN        4096
+
+typedef struct
+{
+    uint32_t        Base;                                                       // начало своей области
+    uint32_t        Seed;
+    uint8_t         Shadow[SCHED_AREA];                                         // ожидаемое содержимое области
+    uint8_t         Buf[512];
+    uint32_t        Errors;
+    uint32_t        Lost;                                                       // потерянные уведомления с индексом 0
+} SCHED_Client_t;
+
+static SCHED_Client_t   clients[SCHED_CLIENTS];
+static TaskHandle_t     tasks[SCHED_CLIENTS], mainTask;
+static uint8_t          shared[SCHED_SHARED_LEN];
+
+static uint32_t Sched_Rand  (SCHED_Client_t *cl)
+{
+    cl->Seed                = cl->Seed * 1103515245u + 12345u;
+    return cl->Seed >> 8;
+}
+
+static bool Sched_Wait      (SCHED_Client_t *cl, uint8_t op, uint32_t addr, uint32_t len, uint8_t *buf)  // запрос через планировщик; задача ждёт и своё уведомление
+{
+    FLASH_Req_t req         = { .Dev = &flash, .Op = op, .Addr = addr, .Len = len, .Buf = buf };
+    xTaskNotifyGive         (xTaskGetCurrentTaskHandle ());
+    bool      ok            = Flash_SubmitWait (&req);
+    if (ulTaskNotifyTake (pdTRUE, 0) != 1)
+        cl->Lost++;
+    return ok;
+}
+
+static void Sched_Client    (void *arg)
+{
+    SCHED_Client_t *cl      = arg;
+    uint32_t  cursor        = 0;                                                // область записана до этого смещения
+    memset                  (cl->Shadow, 0xFF, sizeof (cl->Shadow));
+    for (uint32_t step = 0; step < SCHED_STEPS; step++)
+    {
+        uint32_t  op        = Sched_Rand (cl) % 8;
+        if (op < 4)                                                             // запись продолжения области; область заполнена -> стирание
+        {
+            uint32_t  len   = 1 + Sched_Rand (cl) % 300;
+            len             = len < SCHED_AREA - cursor ? len : SCHED_AREA - cursor;
+            Check_Fill      (cl->Buf, len, Sched_Rand (cl));
+            cl->Errors     += !Sched_Wait (cl, FLASH_REQ_WRITE, cl->Base + cursor, len, cl->Buf);
+            memcpy          (cl->Shadow + cursor, cl->Buf, len);
+            cursor         += len;
+            if (cursor == SCHED_AREA)
+            {
+                cl->Errors += !Sched_Wait (cl, FLASH_REQ_ERASE, cl->Base, SCHED_AREA, NULL);
+                memset      (cl->Shadow, 0xFF, sizeof (cl->Shadow));
+                cursor      = 0;
+            }
+        }
+        else if (op < 6)                                                        // чтение своей области
+        {
+            uint32_t  len   = 1 + Sched_Rand (cl) % sizeof (cl->Buf);
+            uint32_t  off   = Sched_Rand (cl) % (SCHED_AREA - len + 1);
+            cl->Errors     += !Sched_Wait (cl, FLASH_REQ_READ, cl->Base + off, len, cl->Buf);
+            cl->Errors     += memcmp (cl->Buf, cl->Shadow + off, len) != 0;
+        }
+        else                                                                    // общая область: через планировщик (объединяется с чтениями других задач) или напрямую
+        {
+            uint32_t  len   = 1 + Sched_Rand (cl) % sizeof (cl->Buf);
+            uint32_t  off   = Sched_Rand (cl) % (SCHED_SHARED_LEN - len + 1);
+            if (op == 6)
+                cl->Errors += !Sched_Wait (cl, FLASH_REQ_READ, SCHED_SHARED + off, len, cl->Buf);
+            else
+                cl->Errors += !Flash_Read (&flash, SCHED_SHARED + off, len, cl->Buf);
+            cl->Errors     += memcmp (cl->Buf, shared + off, len) != 0;
+        }
+    }
+    xTaskNotifyGive         (mainTask);
+    vTaskDelete             (NULL);
+}
+
+int main                    (void)
+{
+    Model_Reset             (8000000);
+    MODEL_Chip_t *c         = &model.Chip[0];
+    CHECK                   (Check_Init (&flash, 0, &modelW25q16, &modelSpi1));
+    CHECK                   (flash.Mutex != NULL);                              // мьютекс создан до того, как задачи захватывают м/сх
+    Check_Fill              (shared, sizeof (shared), 7);
+    CHECK                   (Flash_Write (&flash, SCHED_SHARED, sizeof (shared), shared));
+    CHECK                   (Flash_SchedInit ());
+
+    mainTask                = xTaskGetCurrentTaskHandle ();
+    for (uint32_t i = 0; i < SCHED_CLIENTS; i++)
+    {
+        clients[i].Base     = i * 65536u;
+        clients[i].Seed     = i + 1;
+        CHECK               (xTaskCreate (Sched_Client, "client", 256, &clients[i], tskIDLE_PRIORITY + 1, &tasks[i]) == pdPASS);
+    }
+    for (uint32_t i = 0; i < SCHED_CLIENTS; i++)                                // завершение всех задач (не дольше минуты)
+        CHECK               (ulTaskNotifyTake (pdFALSE, 60000) == 1);
+
+    Flash_WaitIdle          (&flash);
+    for (uint32_t i = 0; i < SCHED_CLIENTS; i++)
+    {
+        CHECK               (clients[i].Errors == 0 && clients[i].Lost == 0);
+        CHECK               (memcmp (c->Mem + clients[i].Base, clients[i].Shadow, SCHED_AREA) == 0);
+    }
+    CHECK                   (flashSchedStats.Submitted == flashSchedStats.Completed && flashSchedStats.Depth == 0);
+    CHECK                   (flashSchedStats.Submitted >= SCHED_CLIENTS * SCHED_STEPS * 3 / 4);
+    CHECK                   (Check_Clean (c));
+    return CHECK_DONE       ();
+}
@@ -0,0 +1,39 @@
+/*
+ *  Статистика операций (сборка с -D_FLASH_USE_STATS=1): счётчики, байты и задержки по виртуальному времени модели, двоичный снимок.
+ */
+
+#include "check.h"
+
+static uint8_t  buf[256];
+
+int main                    (void)
+{
+    FLASH_Stats_t st;
+    Model_Reset             (8000000);
+    MODEL_Chip_t *c         = &model.Chip[0];
+    CHECK                   (Check_Init (&flash, 0, &modelW25q16, &modelSpi1));
+    Flash_ResetStats        ();
+    CHECK                   (Flash_GetStats (&st) && st.Op[FLASH_STAT_READ].Count == 0);
+
+    CHECK                   (Flash_Read (&flash, 0, sizeof (buf), buf));
+    CHECK                   (Flash_WritePage (&flash, 1, 0, sizeof (buf), buf));
+    Flash_WaitIdle          (&flash);
+    CHECK                   (Flash_EraseRange (&flash, 0, 4096));
+    Flash_WaitIdle          (&flash);
+    CHECK                   (Flash_GetStats (&st));
+    CHECK                   (st.Op[FLASH_STAT_READ].Count == 1 && st.Op[FLASH_STAT_READ].Bytes == sizeof (buf));
+    CHECK                   (st.Op[FLASH_STAT_PROGRAM].Count == 1 && st.Op[FLASH_STAT_PROGRAM].Bytes == sizeof (buf));
+    CHECK                   (st.Op[FLASH_STAT_ERASE].Count == 1);
+    CHECK                   (st.Op[FLASH_STAT_WAIT].Count >= 2);
+    CHECK                   (st.Op[FLASH_STAT_WAIT].MaxUs >= modelW25q16.TeUs[0] / 2);  // ожидание стирания сектора - по времени модели
+    CHECK                   (st.BusyPolls > 0 && st.HalErrors == 0);
+
+    uint8_t   snap[1024];
+    uint32_t  n             = Flash_StatsSnapshot (snap, sizeof (snap));
+    CHECK                   (n == 4 + FLASH_STAT_OPS * (20 + 2 * FLASH_STAT_BUCKETS) + 16 && snap[0] == 'F' && snap[1] == 'S' && snap[2] == FLASH_STATS_VERSION && snap[3] == FLASH_STAT_OPS);
+    CHECK                   (Flash_StatsSnapshot (snap, 4) == 0);               // буфер мал -> снимок не пишется
+    Flash_ResetStats        ();
+    CHECK                   (Flash_GetStats (&st) && st.Op[FLASH_STAT_READ].Count == 0);
+    CHECK                   (Check_Clean (c));
+    return CHECK_DONE       ();
+}
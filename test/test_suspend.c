@@ -0,0 +1,56 @@
+/*
+ *  Приостановка стирания ради чтения на модели м/сх: бюджет приостановок одной операции и ограниченный опрос
+ *  после команды приостановки (м/сх, которая её не выполняет, не удерживает задачу в опросе до срока операции).
+ */
+
+#include "check.h"
+
+static uint8_t  wr[256], rd[256];
+
+static void Test_Budget     (void)
+{
+    Model_Reset             (8000000);
+    MODEL_Chip_t *c         = &model.Chip[0];
+    CHECK                   (Check_Init (&flash, 0, &modelW25q16, &modelSpi1));
+    Check_Fill              (wr, sizeof (wr), 5);
+    CHECK                   (Flash_Write (&flash, 100 * 256, sizeof (wr), wr));
+    CHECK                   (Flash_EraseRange (&flash, 0, 4096));               // стирание сектора 0, чтения - страницы 100
+
+    uint32_t  reads         = 0;
+    for (; reads < 8; reads++)                                                  // первые чтения приостанавливают стирание
+        CHECK               (Flash_Read (&flash, 100 * 256, sizeof (rd), rd) && memcmp (rd, wr, sizeof (wr)) == 0);
+    CHECK                   (flash.Suspends == 8 && c->Suspends == 8 && flash.Pending == FLASH_OP_ERASE);
+    CHECK                   (Flash_Read (&flash, 100 * 256, sizeof (rd), rd) && memcmp (rd, wr, sizeof (wr)) == 0);
+    CHECK                   (flash.Suspends == 8 && flash.Pending == FLASH_OP_NONE);  // бюджет исчерпан: чтение дождалось конца стирания
+
+    CHECK                   (Flash_EraseRange (&flash, 4096, 4096));            // новая операция - новый бюджет
+    CHECK                   (Flash_Read (&flash, 100 * 256, sizeof (rd), rd) && memcmp (rd, wr, sizeof (wr)) == 0);
+    CHECK                   (flash.Suspends == 9 && flash.Pending == FLASH_OP_ERASE && c->Erases == 2);
+    Flash_WaitIdle          (&flash);
+    CHECK                   (Check_Clean (c));
+}
+
+static void Test_NoSuspend  (void)
+{
+    MODEL_Part_t part       = modelW25q16;                                      // м/сх игнорирует приостановку, хотя драйвер считает её поддерживаемой
+    part.NoSuspend          = true;
+    Model_Reset             (8000000);
+    MODEL_Chip_t *c         = &model.Chip[0];
+    CHECK                   (Check_Init (&flash, 0, &part, &modelSpi1));
+    Check_Fill              (wr, sizeof (wr), 6);
+    CHECK                   (Flash_Write (&flash, 100 * 256, sizeof (wr), wr));
+    Flash_WaitIdle          (&flash);
+    uint32_t  polls         = c->Cmds[0x05];
+    CHECK                   (Flash_EraseRange (&flash, 0, 4096));
+    CHECK                   (Flash_Read (&flash, 100 * 256, sizeof (rd), rd) && memcmp (rd, wr, sizeof (wr)) == 0);
+    CHECK                   (flash.Suspends == 0 && c->Suspends == 0 && c->Erases == 1);
+    CHECK                   (c->Cmds[0x05] - polls < 10);                       // опрос после приостановки - несколько tSUS, затем сон до конца стирания
+    CHECK                   (Check_Clean (c));
+}
+
+int main                    (void)
+{
+    Test_Budget             ();
+    Test_NoSuspend          ();
+    return CHECK_DONE       ();
+}
@@ -0,0 +1,122 @@
+/*
+ *  Количество вызовов HAL на операцию: команда, адрес и фиктивные байты уходят одной посылкой, фаза данных - второй.
+ *  Опросы регистра состояния в ожидании готовности учитываются отдельно. Flash_ReadV/Flash_WriteV передают все сегменты
+ *  в одном Chip Select, AT45DBXXX при записи сегментов сохраняет остальные байты страницы.
+ */
+
+#include "check.h"
+
+bool Flash_IsBusy (FLASH_t *dev);
+
+typedef struct
+{
+    uint32_t    Calls;                                                          // вызовы HAL без опросов состояния
+    uint32_t    Selects;                                                        // посылки (Chip Select) без опросов состояния
+    uint32_t    Polls;                                                          // опросы регистра состояния
+} XFER_Count_t;
+
+static uint32_t Xfer_Polls  (const MODEL_Chip_t *c)
+{
+    return c->Cmds[0x05] + c->Cmds[0xD7];
+}
+
+#define XFER_COUNT(res, expr)   do { const MODEL_Chip_t *_c = &model.Chip[0];                                   \
+                                     uint32_t _calls = model.Calls, _sel = _c->Selects, _polls = Xfer_Polls (_c);  \
+                                     expr;                                                                      \
+                                     (res).Polls   = Xfer_Polls (_c) - _polls;                                  \
+                                     (res).Calls   = model.Calls - _calls - (res).Polls;                        \
+                                     (res).Selects = _c->Selects - _sel - (res).Polls;                          \
+                                     printf ("  %-42s HAL %3u  CS %3u  polls %3u\n", #expr, (res).Calls, (res).Selects, (res).Polls); \
+                                 } while (0)
+
+static uint8_t  buf[1056];
+
+static void Test_Part       (const MODEL_Part_t *part)
+{
+    XFER_Count_t n;
+    bool      nor           = !part->At45;
+    Model_Reset             (8000000);
+    Model_Attach            (0, part, &modelSpi1);
+    printf                  ("%s:\n", part->Name);
+    XFER_Count_t init;
+    XFER_COUNT              (init, Flash_Init (&flash));
+    CHECK                   (init.Calls <= 2 * init.Selects);                   // не больше двух вызовов HAL на посылку
+    uint16_t  pg            = flash.PgSize;
+
+    XFER_COUNT              (n, Flash_IsBusy (&flash));
+    CHECK                   (n.Calls == 0 && n.Polls == 1);                     // опрос - один вызов HAL
+
+    XFER_COUNT              (n, Flash_ReadPage (&flash, 3, 0, pg, buf));
+    CHECK                   (n.Calls == 2 && n.Selects == 1);                   // заголовок + данные (DMA)
+    XFER_COUNT              (n, Flash_ReadPage (&flash, 3, 8, 16, buf));
+    CHECK                   (n.Calls == 2 && n.Selects == 1);
+
+    XFER_COUNT              (n, Flash_WritePage (&flash, 3, 0, pg, buf));
+    CHECK                   (n.Calls == (nor ? 3u : 2u) && n.Selects == (nor ? 2u : 1u));  // NOR: 0x06 + программирование
+    XFER_COUNT              (n, Flash_WaitIdle (&flash));
+    CHECK                   (n.Calls == 0);
+
+    XFER_COUNT              (n, Flash_WritePage (&flash, 4, 10, 16, buf));      // часть страницы (AT45DBXXX: 0x53, 0x84 с данными, 0x83)
+    CHECK                   (n.Calls == (nor ? 3u : 4u) && n.Selects == (nor ? 2u : 3u));
+    XFER_COUNT              (n, Flash_WaitIdle (&flash));
+
+    XFER_COUNT              (n, Flash_EraseArea (&flash, 1));
+    CHECK                   (n.Calls == (nor ? 2u : 1u) && n.Selects == n.Calls);  // NOR: 0x06 + стирание, AT45DBXXX: стирание
+    XFER_COUNT              (n, Flash_WaitIdle (&flash));
+
+    uint32_t  dma           = model.DmaCalls;                                   // режим исключения лишних записей: сравнение порциями без DMA
+    uint32_t  area          = flash.ErasableSize;
+    flash.WriteAvoid        = true;
+    XFER_COUNT              (n, Flash_EraseArea (&flash, 1));                   // область уже стёрта: только чтение
+    CHECK                   (n.Calls == 1 + (area + 63) / 64 && n.Selects == 1);
+    CHECK                   (model.DmaCalls == dma && flash.SkippedErases == 1);
+    flash.WriteAvoid        = false;
+    CHECK                   (Check_Clean (&model.Chip[0]));
+}
+
+static void Test_Vec        (const MODEL_Part_t *part)
+{
+    static uint8_t  page[1056], hdr[8], data[40], tail[3], got[1056];
+    XFER_Count_t n;
+    bool      nor           = !part->At45;
+    Model_Reset             (8000000);
+    MODEL_Chip_t *c         = &model.Chip[0];
+    CHECK                   (Check_Init (&flash, 0, part, &modelSpi1));
+    uint16_t  pg            = flash.PgSize;
+    printf                  ("%s, сегменты:\n", part->Name);
+
+    Check_Fill              (page, pg, 11);                                     // страница 3: байты вне [100, 151) записаны заранее, сама область стёрта
+    memset                  (page + 100, 0xFF, 51);
+    CHECK                   (Flash_WritePage (&flash, 3, 0, pg, page));
+    Flash_WaitIdle          (&flash);
+
+    Check_Fill              (hdr, sizeof (hdr), 12);
+    Check_Fill              (data, sizeof (data), 13);
+    Check_Fill              (tail, sizeof (tail), 14);
+    const FLASH_Seg_t wseg[4] = { { hdr, sizeof (hdr) }, { data, sizeof (data) }, { NULL, 0 }, { tail, sizeof (tail) } };
+    XFER_COUNT              (n, Flash_WriteV (&flash, 3, 100, wseg, 4));
+    CHECK                   (n.Selects == (nor ? 2u : 3u));                     // NOR: 0x06 + программирование, AT45DBXXX: 0x53, 0x84 со всеми сегментами, 0x83
+    CHECK                   (n.Calls == n.Selects + 3);                         // заголовок посылки с данными и по вызову на непустой сегмент
+    CHECK                   (c->Cmds[nor ? 0x02 : 0x84] == (nor ? 2u : 1u));    // данные - одной посылкой (NOR: вторая после записи страницы целиком)
+    Flash_WaitIdle          (&flash);
+    memcpy                  (page + 100, hdr, sizeof (hdr));
+    memcpy                  (page + 108, data, sizeof (data));
+    memcpy                  (page + 148, tail, sizeof (tail));
+    CHECK                   (memcmp (c->Mem + Model_Offset (c, 3), page, pg) == 0);  // остальные байты страницы сохранены
+
+    memset                  (got, 0, sizeof (got));                             // чтение через границу страниц 3 и 4 в три буфера
+    const FLASH_Seg_t rseg[4] = { { got, 20 }, { NULL, 0 }, { got + 20, 200 }, { got + 220, pg - 110 } };
+    XFER_COUNT              (n, Flash_ReadV (&flash, 3 * pg + 90, rseg, 4));
+    CHECK                   (n.Selects == 1 && n.Calls == 4 && n.Polls == 0);
+    CHECK                   (memcmp (got, page + 90, pg - 90) == 0 && memcmp (got + pg - 90, c->Mem + Model_Offset (c, 4), 110) == 0);
+    CHECK                   (Check_Clean (c));
+}
+
+int main                    (void)
+{
+    Test_Part               (&modelW25q16);
+    Test_Part               (&modelAt45db161e);
+    Test_Vec                (&modelW25q16);
+    Test_Vec                (&modelAt45db161e);
+    return CHECK_DONE       ();
+}